@@ -58,3 +58,393 @@ void test() {
 // asdfg
 
 
+
+// std::regex is general and convenient, but it is usually implemented by backtracking, it is not fast,
+// and reading line by line with getline() plus an smatch per line adds allocation to every line.
+// For scanning large amounts of text, a pattern can instead be compiled into a deterministic finite automaton (DFA):
+// a table giving, for each state and each byte, the next state. Matching is then one table lookup per byte.
+// The Dfa below handles a useful subset of the regex syntax: literals, ., \w \d \s (and \W \D \S), [classes],
+// grouping with ( ), alternation |, and the repetitions * + ? {n} {n,} {n,m}. The anchors ^ and $ are not supported
+// (a regex_error is thrown; use \^ and \$ for the characters themselves).
+// Unlike std::regex's default (ECMAScript) rules, it finds the leftmost-longest match, and it reports no submatches.
+// When a whole buffer is scanned in one go, a pattern such as \s* could match across a line break; a Dfa built with
+// Span::line never lets a match contain '\n', so every match lies within a single line.
+class Dfa {
+public:
+    enum class Span { text, line }; // may a match cross a '\n'?
+
+    explicit Dfa(string_view pattern, Span span = Span::text)
+    {
+        size_t pos = 0;
+        Node ast = parse_alt(pattern,pos);
+        if (pos!=pattern.size())
+            throw regex_error{regex_constants::error_paren}; // an unmatched )
+        Frag f = build(ast);
+        int m = add({Nstate::match});
+        patch(f.outs,m);
+        determinize(f.start);
+        if (span==Span::line)
+            for (auto& t : trans)
+                t['\n'] = dead; // a '\n' ends every match
+        for (int c = 0; c!=256; ++c)
+            first[c] = trans[0][c]!=dead;
+    }
+
+    struct Match {
+        size_t pos; // offset of the first character of the match
+        size_t len;
+    };
+
+    // Call f(Match) for each non-overlapping match in text; no allocation, no copying of text:
+    template<typename F>
+    void for_each_match(string_view text, F f) const
+    {
+        const auto* p = reinterpret_cast<const unsigned char*>(text.data());
+        size_t n = text.size();
+        for (size_t i = 0; i<n; ) {
+            while (i<n && !first[p[i]]) // skip bytes that can't start a match
+                ++i;
+            if (i==n)
+                break;
+            size_t len = longest_at(p+i,n-i);
+            if (len) {
+                f(Match{i,len});
+                i += len;
+            }
+            else
+                ++i;
+        }
+    }
+
+    optional<Match> search(string_view text) const // the first match, if any
+    {
+        optional<Match> res;
+        for_each_match(text,[&](Match m) { if (!res) res = m; }); // (a real search would stop early)
+        return res;
+    }
+
+private:
+    // The pattern is first parsed into a tree ...
+    struct Node {
+        enum Kind { set, cat, alt, repeat } kind;
+        bitset<256> chars; // for set
+        vector<Node> kids; // for cat, alt, repeat (one kid)
+        int min = 0;
+        int max = 0; // -1 means unbounded
+    };
+
+    static bitset<256> class_of(char c) // \w, \d, \s, and their complements
+    {
+        bitset<256> b;
+        for (int i = 0; i!=128; ++i) {
+            bool in = false;
+            switch (tolower(c)) {
+            case 'w': in = isalnum(i) || i=='_'; break;
+            case 'd': in = isdigit(i); break;
+            case 's': in = isspace(i); break;
+            }
+            b[i] = in;
+        }
+        return isupper(c) ? ~b : b;
+    }
+
+    static bitset<256> escape(string_view p, size_t& pos)
+    {
+        if (pos==p.size())
+            throw regex_error{regex_constants::error_escape};
+        char c = p[pos++];
+        if (string_view{"wdsWDS"}.find(c)!=string_view::npos)
+            return class_of(c);
+        bitset<256> b;
+        b[static_cast<unsigned char>(c)] = true; // \. \- \\ etc.
+        return b;
+    }
+
+    static Node parse_alt(string_view p, size_t& pos)
+    {
+        Node n {Node::alt};
+        n.kids.push_back(parse_cat(p,pos));
+        while (pos<p.size() && p[pos]=='|') {
+            ++pos;
+            n.kids.push_back(parse_cat(p,pos));
+        }
+        return n.kids.size()==1 ? move(n.kids[0]) : n;
+    }
+
+    static Node parse_cat(string_view p, size_t& pos)
+    {
+        Node n {Node::cat};
+        while (pos<p.size() && p[pos]!='|' && p[pos]!=')')
+            n.kids.push_back(parse_repeat(p,pos));
+        return n;
+    }
+
+    static int parse_int(string_view p, size_t& pos)
+    {
+        int x = 0;
+        auto [ptr,ec] = from_chars(p.data()+pos,p.data()+p.size(),x);
+        if (ec!=errc{})
+            throw regex_error{regex_constants::error_badbrace};
+        pos = ptr-p.data();
+        return x;
+    }
+
+    static Node parse_repeat(string_view p, size_t& pos)
+    {
+        Node n = parse_atom(p,pos);
+        while (pos<p.size() && string_view{"*+?{"}.find(p[pos])!=string_view::npos) {
+            Node r {Node::repeat};
+            char q = p[pos++];
+            if (q=='*') { r.min = 0; r.max = -1; }
+            else if (q=='+') { r.min = 1; r.max = -1; }
+            else if (q=='?') { r.min = 0; r.max = 1; }
+            else { // {n} {n,} {n,m}
+                r.min = r.max = parse_int(p,pos);
+                if (pos<p.size() && p[pos]==',') {
+                    ++pos;
+                    r.max = (pos<p.size() && p[pos]=='}') ? -1 : parse_int(p,pos);
+                }
+                if (pos==p.size() || p[pos++]!='}' || (r.max!=-1 && r.max<r.min))
+                    throw regex_error{regex_constants::error_brace};
+            }
+            r.kids.push_back(move(n));
+            n = move(r);
+        }
+        return n;
+    }
+
+    static Node parse_atom(string_view p, size_t& pos)
+    {
+        Node n {Node::set};
+        char c = p[pos++];
+        switch (c) {
+        case '(':
+            n = parse_alt(p,pos);
+            if (pos==p.size() || p[pos++]!=')')
+                throw regex_error{regex_constants::error_paren};
+            break;
+        case '[':
+        {
+            bool negate = pos<p.size() && p[pos]=='^';
+            if (negate)
+                ++pos;
+            while (pos<p.size() && p[pos]!=']') {
+                if (p[pos]=='\\') {
+                    ++pos;
+                    n.chars |= escape(p,pos);
+                    continue;
+                }
+                unsigned char lo = p[pos++];
+                unsigned char hi = lo;
+                if (pos+1<p.size() && p[pos]=='-' && p[pos+1]!=']') { // a range, such as a-z
+                    hi = p[pos+1];
+                    pos += 2;
+                }
+                for (int i = lo; i<=hi; ++i)
+                    n.chars[i] = true;
+            }
+            if (pos==p.size())
+                throw regex_error{regex_constants::error_brack};
+            ++pos; // skip ]
+            if (negate)
+                n.chars.flip();
+            break;
+        }
+        case '.':
+            n.chars.set();
+            n.chars['\n'] = false;
+            break;
+        case '\\':
+            n.chars = escape(p,pos);
+            break;
+        case '*': case '+': case '?': case '{':
+            throw regex_error{regex_constants::error_badrepeat}; // nothing to repeat
+        case '^': case '$':
+            throw regex_error{regex_constants::error_complexity}; // an anchor: not supported, rather than taken literally
+        default:
+            n.chars[static_cast<unsigned char>(c)] = true;
+        }
+        return n;
+    }
+
+    // ... then the tree is turned into a nondeterministic automaton (NFA), one fragment per node ...
+    struct Nstate {
+        enum Kind { set, eps, split, match } kind;
+        bitset<256> chars;
+        int out = -1;
+        int out1 = -1; // second successor, for split
+    };
+    struct Frag {
+        int start;
+        vector<pair<int,int>> outs; // dangling successors: (state, 0 for out or 1 for out1)
+    };
+
+    int add(Nstate s)
+    {
+        nfa.push_back(s);
+        return nfa.size()-1;
+    }
+    void patch(const vector<pair<int,int>>& outs, int target)
+    {
+        for (auto [s,which] : outs)
+            (which ? nfa[s].out1 : nfa[s].out) = target;
+    }
+
+    Frag build(const Node& n) // each call makes fresh states, so {n,m} can copy its operand
+    {
+        switch (n.kind) {
+        case Node::set:
+        {
+            int s = add({Nstate::set,n.chars});
+            return {s,{{s,0}}};
+        }
+        case Node::cat:
+        {
+            int s = add({Nstate::eps});
+            Frag f {s,{{s,0}}};
+            for (auto& k : n.kids) {
+                Frag g = build(k);
+                patch(f.outs,g.start);
+                f.outs = move(g.outs);
+            }
+            return f;
+        }
+        case Node::alt:
+        {
+            Frag f = build(n.kids[0]);
+            for (size_t i = 1; i<n.kids.size(); ++i) {
+                Frag g = build(n.kids[i]);
+                int s = add({Nstate::split,{},f.start,g.start});
+                f.start = s;
+                f.outs.insert(f.outs.end(),g.outs.begin(),g.outs.end());
+            }
+            return f;
+        }
+        case Node::repeat:
+        default:
+        {
+            int s = add({Nstate::eps});
+            Frag f {s,{{s,0}}};
+            for (int i = 0; i<n.min; ++i) { // the required copies
+                Frag g = build(n.kids[0]);
+                patch(f.outs,g.start);
+                f.outs = move(g.outs);
+            }
+            if (n.max==-1) { // then a loop ...
+                Frag g = build(n.kids[0]);
+                int loop = add({Nstate::split,{},g.start,-1});
+                patch(g.outs,loop);
+                patch(f.outs,loop);
+                f.outs = {{loop,1}};
+            }
+            else {
+                for (int i = n.min; i<n.max; ++i) { // ... or the optional copies
+                    Frag g = build(n.kids[0]);
+                    int opt = add({Nstate::split,{},g.start,-1});
+                    patch(f.outs,opt);
+                    f.outs = move(g.outs);
+                    f.outs.push_back({opt,1});
+                }
+            }
+            return f;
+        }
+        }
+    }
+
+    // ... and finally each set of NFA states that can be active at the same time becomes one DFA state:
+    void closure(int s, vector<int>& set) const
+    {
+        if (s<0 || ranges::find(set,s)!=set.end())
+            return;
+        set.push_back(s);
+        if (nfa[s].kind==Nstate::eps || nfa[s].kind==Nstate::split) {
+            closure(nfa[s].out,set);
+            closure(nfa[s].out1,set);
+        }
+    }
+
+    void determinize(int start)
+    {
+        constexpr size_t max_states = 10'000; // some patterns explode; refuse rather than eat all memory
+        map<vector<int>,int> ids;
+        vector<vector<int>> sets;
+        auto id_of = [&](vector<int> set) {
+            ranges::sort(set);
+            auto [p,inserted] = ids.try_emplace(set,sets.size());
+            if (inserted) {
+                if (sets.size()==max_states)
+                    throw regex_error{regex_constants::error_complexity};
+                sets.push_back(set);
+                trans.emplace_back();
+                trans.back().fill(dead);
+                accept.push_back(any_of(set.begin(),set.end(),[&](int s) { return nfa[s].kind==Nstate::match; }));
+            }
+            return p->second;
+        };
+        vector<int> s0;
+        closure(start,s0);
+        id_of(s0);
+        for (size_t d = 0; d<sets.size(); ++d) { // sets grows as new states are discovered
+            for (int c = 0; c!=256; ++c) {
+                vector<int> next;
+                for (int s : sets[d])
+                    if (nfa[s].kind==Nstate::set && nfa[s].chars[c])
+                        closure(nfa[s].out,next);
+                if (!next.empty())
+                    trans[d][c] = id_of(move(next));
+            }
+        }
+    }
+
+    size_t longest_at(const unsigned char* p, size_t n) const // length of the longest match starting at p; 0 if none
+    {
+        size_t best = 0;
+        int s = 0;
+        for (size_t i = 0; i!=n; ++i) {
+            s = trans[s][p[i]];
+            if (s==dead)
+                break;
+            if (accept[s])
+                best = i+1;
+        }
+        return best;
+    }
+
+    static constexpr int dead = -1;
+    vector<Nstate> nfa; // needed only while compiling
+    vector<array<int,256>> trans; // trans[state][byte]: the DFA
+    vector<bool> accept;
+    array<bool,256> first {}; // can a match start with this byte?
+};
+
+// Compile the pattern once; then scan a whole buffer (e.g., a file read in one go) and report offsets.
+// Unlike f() and use(), which report only the first match on a line, scan() reports every match:
+void scan(string_view text)
+{
+    static const Dfa postal {R"(\w{2}\s*\d{5}(-\d{4})?)",Dfa::Span::line}; // U.S. postal code pattern; within a line, as in use()
+    int lineno = 1;
+    size_t counted = 0; // newlines are counted in [0:counted)
+    postal.for_each_match(text,[&](Dfa::Match m) {
+        lineno += count(text.begin()+counted,text.begin()+m.pos,'\n');
+        counted = m.pos;
+        string_view code = text.substr(m.pos,m.len); // refers into text: no copy
+        cout << lineno << ": " << code << '\n';
+        if (5<code.size() && code[code.size()-5]=='-') // no submatches, but the optional -dddd is easy to see
+            cout << "\t: " << code.substr(code.size()-5) << '\n';
+    });
+}
+
+// use() can read through an Input_source (§11.9) instead: each line is a string_view into the mapped file,
+// and a cmatch (match_results<const char*>) refers to the same characters:
+void use_mapped() {
+    Input_source in {path{"file.txt"}}; // throws if the file can't be opened
+    regex pat {R"(\w{2}\s*\d{5}(-\d{4})?)"};
+    int lineno = 0;
+    for (string_view line : in.lines()) {
+        ++lineno;
+        cmatch matches;
+        if (regex_search(line.data(), line.data()+line.size(), matches, pat))
+            cout << lineno << ": " << matches[0] << '\n';
+    }
+}
+// Better still, scan(in.all()) searches the whole file with the Dfa in one pass (reporting all matches on a line, not just the first).
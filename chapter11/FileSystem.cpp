@@ -68,4 +68,175 @@ void test(path p)
         }
     }
 }
-// We use a path as a string (e.g., f.extension) and we can extract strings of various types from a path (e.g., f.extension().string())
\ No newline at end of file
+// We use a path as a string (e.g., f.extension) and we can extract strings of various types from a path (e.g., f.extension().string())
+// Reading a file through an ifstream copies every character at least twice: from the operating system into the
+// stream's buffer and from there into the strings we read into. For large files, we can instead ask the operating
+// system to map the file into memory (POSIX mmap(), from <sys/mman.h>) and look at it through string_views.
+// A pipe or a terminal can't be mapped, so an Input_source falls back to reading blocks into a buffer of its own.
+// It hands out lines and whitespace-separated words as string_views:
+// • if stable() (the file is mapped, or the source is a string_view), a view stays valid as long as the Input_source
+// • otherwise, a view is valid only until the next line or word is requested
+class Input_source {
+public:
+    explicit Input_source(const path& p) : fd{::open(p.c_str(),O_RDONLY)}
+    {
+        if (fd<0)
+            throw system_error{errno,system_category(),"can't open "+p.string()};
+        struct stat st;
+        if (::fstat(fd,&st)==0 && S_ISREG(st.st_mode)) { // an ordinary file: map it
+            size_t n = st.st_size;
+            if (n==0) {
+                text = {};
+                stable_view = true;
+                return;
+            }
+            void* m = ::mmap(nullptr,n,PROT_READ,MAP_PRIVATE,fd,0);
+            if (m!=MAP_FAILED) {
+                ::madvise(m,n,MADV_SEQUENTIAL); // we read front to back: read ahead aggressively, drop pages behind us
+                text = {static_cast<const char*>(m),n};
+                mapping = m;
+                stable_view = true;
+            }
+        }
+    }
+    explicit Input_source(int file_descriptor) : fd{file_descriptor}, own_fd{false} {} // e.g., Input_source{0} for standard input
+    explicit Input_source(string_view s) : text{s}, stable_view{true} {} // text that is already in memory
+
+    Input_source(const Input_source&) = delete;
+    Input_source& operator=(const Input_source&) = delete;
+    ~Input_source()
+    {
+        if (mapping)
+            ::munmap(mapping,text.size());
+        if (fd>=0 && own_fd)
+            ::close(fd);
+    }
+
+    bool stable() const { return stable_view; }
+
+    string_view all() // the rest of the input as a single view; for an unmapped source, this reads everything
+    {
+        if (!stable_view) {
+            while (fill())
+                ;
+            stable_view = true; // nothing more will be read, so the buffer won't move again
+        }
+        string_view res = text.substr(pos);
+        pos = text.size();
+        return res;
+    }
+
+    bool next_line(string_view& line) // the next line, without its '\n'
+    {
+        size_t nl;
+        while ((nl = text.find('\n',pos))==string_view::npos)
+            if (!fill())
+                break;
+        if (pos==text.size())
+            return false;
+        size_t end = (nl==string_view::npos) ? text.size() : nl; // the last line need not end with '\n'
+        line = text.substr(pos,end-pos);
+        pos = (nl==string_view::npos) ? end : end+1;
+        return true;
+    }
+
+    bool next_word(string_view& word) // the next whitespace-separated word, like is>>s
+    {
+        auto space = [](char c) { return isspace(static_cast<unsigned char>(c)); };
+        while (true) { // skip whitespace
+            while (pos<text.size() && space(text[pos]))
+                ++pos;
+            if (pos<text.size() || !fill())
+                break;
+        }
+        if (pos==text.size())
+            return false;
+        size_t end = pos;
+        while (true) {
+            while (end<text.size() && !space(text[end]))
+                ++end;
+            if (end<text.size())
+                break;
+            size_t off = end-pos;
+            if (!fill()) // fill() may move the text, but keeps it from pos on
+                break;
+            end = pos+off;
+        }
+        word = text.substr(pos,end-pos);
+        pos = end;
+        return true;
+    }
+
+    // Ranges of lines and words, so that we can write for (string_view s : in.lines()):
+    template<bool (Input_source::*next)(string_view&)>
+    class Pieces {
+    public:
+        class iterator {
+        public:
+            using value_type = string_view;
+            using difference_type = ptrdiff_t;
+            iterator() = default;
+            explicit iterator(Input_source* s) : src{s} { ++*this; }
+            string_view operator*() const { return cur; }
+            iterator& operator++()
+            {
+                if (!(src->*next)(cur))
+                    src = nullptr;
+                return *this;
+            }
+            void operator++(int) { ++*this; }
+            bool operator==(default_sentinel_t) const { return src==nullptr; }
+        private:
+            Input_source* src = nullptr;
+            string_view cur;
+        };
+        explicit Pieces(Input_source& s) : src{&s} {}
+        iterator begin() { return iterator{src}; }
+        default_sentinel_t end() const { return {}; }
+    private:
+        Input_source* src;
+    };
+    auto lines() { return Pieces<&Input_source::next_line>{*this}; }
+    auto words() { return Pieces<&Input_source::next_word>{*this}; }
+
+private:
+    bool fill() // read another block; false at end of input (or if the text is all there already)
+    {
+        if (stable_view || fd<0)
+            return false;
+        buf.erase(0,pos); // keep only what hasn't been consumed yet
+        pos = 0;
+        size_t old = buf.size();
+        buf.resize(old+block);
+        ssize_t n;
+        do
+            n = ::read(fd,buf.data()+old,block);
+        while (n<0 && errno==EINTR);
+        buf.resize(old+max<ssize_t>(n,0));
+        text = buf;
+        if (n<0)
+            throw system_error{errno,system_category(),"read failed"};
+        return n>0;
+    }
+
+    static constexpr size_t block = 64*1024;
+    int fd = -1;
+    bool own_fd = true;
+    void* mapping = nullptr;
+    string_view text; // the mapped file, the given text, or buf
+    size_t pos = 0; // next unread character in text
+    bool stable_view = false;
+    string buf; // for input that can't be mapped
+};
+
+void count_lines(const path& p)
+{
+    Input_source in {p};
+    int lines = 0;
+    size_t chars = 0;
+    for (string_view line : in.lines()) { // no string is created
+        ++lines;
+        chars += line.size();
+    }
+    cout << p << ": " << lines << " lines, " << chars << " characters\n";
+}
@@ -41,3 +41,109 @@ void f() {
 // The output is:
 // { "John Marwood Cleese", 123456 }
 // {"Michael Edward Palin", 987654}
+
+// operator>>() is fine for a few Entries, but each character goes through the stream machinery and the name
+// is built one character at a time. For large inputs, it is far faster to get all the text into memory
+// (e.g., with an Input_source, §11.9) and parse it directly:
+// • the number is converted with from_chars() (from <charconv>): no locale, no stream state, no allocation
+// • the name is not copied into a string: we refer to it with a string_view, either into the input itself
+//   or, if the input buffer is about to be reused, into a String_arena that keeps copies in large blocks
+// • an error is reported with its position in the input, rather than just setting failbit
+struct Entry_view {
+    string_view name;
+    int number;
+};
+
+struct Parse_error {
+    size_t offset; // position in the input of the character that couldn't be parsed
+    const char* what;
+};
+
+class String_arena { // stores many strings in few allocations; they all go away together
+public:
+    string_view store(string_view s)
+    {
+        if (blocks.empty() || cap-used<s.size()) {
+            cap = max(block_size,s.size()); // a long string gets a block of its own size
+            blocks.push_back(make_unique<char[]>(cap));
+            used = 0;
+        }
+        char* p = blocks.back().get()+used;
+        copy(s.begin(),s.end(),p);
+        used += s.size();
+        return {p,s.size()};
+    }
+private:
+    static constexpr size_t block_size = 64*1024;
+    vector<unique_ptr<char[]>> blocks;
+    size_t cap = 0; // size of blocks.back()
+    size_t used = 0; // in blocks.back()
+};
+
+// Call f(Entry_view) for each { "name" , number } in buf; stop at the first error:
+template<typename F>
+optional<Parse_error> for_each_entry(string_view buf, F f)
+{
+    const char* first = buf.data();
+    const char* p = first;
+    const char* end = first+buf.size();
+    auto skip_ws = [&] { while (p!=end && isspace(static_cast<unsigned char>(*p))) ++p; };
+    auto expect = [&](char c) { skip_ws(); if (p==end || *p!=c) return false; ++p; return true; };
+    auto error = [&](const char* what) { return Parse_error{static_cast<size_t>(p-first),what}; };
+
+    while (true) {
+        skip_ws();
+        if (p==end)
+            return {}; // done: no error
+        if (!expect('{'))
+            return error("'{' expected");
+        if (!expect('"'))
+            return error("'\"' expected");
+        const char* name = p;
+        p = find(p,end,'"'); // anything before a " is part of the name
+        if (p==end)
+            return error("unterminated name");
+        string_view nm {name,static_cast<size_t>(p-name)};
+        ++p;
+        if (!expect(','))
+            return error("',' expected");
+        skip_ws();
+        if (p!=end && *p=='+') { // >> accepts a leading +; from_chars() doesn't
+            ++p;
+            if (p!=end && *p=='-') // but not +-5, which from_chars() would read as -5
+                return error("number expected");
+        }
+        int number = 0;
+        auto [q,ec] = from_chars(p,end,number);
+        if (ec==errc::result_out_of_range)
+            return error("number too large");
+        if (ec!=errc{})
+            return error("number expected");
+        p = q;
+        if (!expect('}'))
+            return error("'}' expected");
+        f(Entry_view{nm,number});
+    }
+}
+
+// Collect the entries; with an arena, the names no longer refer into buf:
+optional<Parse_error> parse_entries(string_view buf, vector<Entry_view>& res, String_arena* arena = nullptr)
+{
+    res.reserve(res.size()+count(buf.begin(),buf.end(),'{')); // a good estimate of the number of entries
+    return for_each_entry(buf,[&](Entry_view e) {
+        if (arena)
+            e.name = arena->store(e.name);
+        res.push_back(e);
+    });
+}
+
+void f2(string_view text)
+{
+    vector<Entry_view> entries;
+    if (auto err = parse_entries(text,entries)) {
+        cerr << "bad input at offset " << err->offset << ": " << err->what << '\n';
+        return;
+    }
+    for (auto e : entries)
+        cout << "{\"" << e.name << "\", " << e.number << "}\n";
+}
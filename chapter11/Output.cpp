@@ -27,3 +27,228 @@ void f1() {
     cout << 'a' << b << c;
 }
 // The integer value of the character 'b' is 98, so this will output a98c.
+
+// Each << on cout is a function call that checks the stream state, consults the locale, and copies into the stream's buffer;
+// with small tokens, that overhead dominates. An Output_sink is a much simpler output channel for bulk output:
+// • characters are appended to a large buffer of our own
+// • full buffers are kept until several have accumulated, and are then written with a single writev() system call
+// • optionally, a background thread does the writing, so that the producer never waits for the system
+// • an output iterator lets algorithms (and format_to()) write straight into the buffer
+class Output_sink {
+public:
+    explicit Output_sink(int file_descriptor, bool background = false, size_t buffer_size = 64*1024)
+        : fd{file_descriptor}, bufsz{buffer_size}
+    {
+        cur.reserve(bufsz);
+        if (background)
+            flusher = jthread{[this](stop_token tok) { flush_loop(tok); }};
+    }
+    Output_sink(const Output_sink&) = delete;
+    Output_sink& operator=(const Output_sink&) = delete;
+    ~Output_sink()
+    {
+        try { flush(); } catch (...) {} // a destructor mustn't throw; call flush() explicitly to see errors
+        if (flusher.joinable()) {
+            {
+                scoped_lock lck {mtx}; // so that the flusher can't miss the request between its check and its wait
+                flusher.request_stop();
+            }
+            cv.notify_all();
+        }
+    }
+
+    void put(char c)
+    {
+        if (cur.size()==bufsz)
+            hand_over();
+        cur.push_back(c);
+    }
+
+    void write(string_view s)
+    {
+        while (!s.empty()) {
+            if (cur.size()==bufsz)
+                hand_over();
+            size_t n = min(s.size(),bufsz-cur.size());
+            cur.append(s.substr(0,n));
+            s.remove_prefix(n);
+        }
+    }
+
+    void flush() // write everything written so far, and wait for it to be written
+    {
+        hand_over();
+        if (flusher.joinable()) {
+            unique_lock lck {mtx};
+            cv.notify_all();
+            cv.wait(lck,[this] { return full.empty() && !writing; });
+            if (error)
+                throw system_error{exchange(error,0),system_category(),"Output_sink"};
+        }
+        else {
+            write_out(full);
+            full.clear();
+        }
+    }
+
+    // An output iterator, so that copy(), format_to(), etc. can write to a sink:
+    class iterator {
+    public:
+        using difference_type = ptrdiff_t;
+        explicit iterator(Output_sink& s) : sink{&s} {}
+        iterator& operator=(char c) { sink->put(c); return *this; }
+        iterator& operator*() { return *this; }
+        iterator& operator++() { return *this; }
+        iterator operator++(int) { return *this; }
+    private:
+        Output_sink* sink;
+    };
+    iterator out() { return iterator{*this}; }
+
+private:
+    static constexpr size_t max_batch = 16; // buffers per writev()
+
+    void hand_over() // move the current buffer to the list of full ones; perhaps write them
+    {
+        if (cur.empty())
+            return;
+        if (flusher.joinable()) {
+            string next;
+            {
+                unique_lock lck {mtx};
+                cv.wait(lck,[this] { return full.size()<max_batch; }); // don't run ahead of a slow file: wait for the writer
+                full.push_back(move(cur));
+                if (!spare.empty()) { // reuse a buffer that has been written: no allocation
+                    next = move(spare.back());
+                    spare.pop_back();
+                }
+            }
+            cv.notify_all();
+            cur = move(next);
+        }
+        else {
+            full.push_back(move(cur));
+            cur = string{};
+            if (full.size()==max_batch) {
+                write_out(full);
+                full.clear();
+            }
+        }
+        cur.clear();
+        cur.reserve(bufsz);
+    }
+
+    void write_out(const vector<string>& bufs) // write bufs with as few system calls as possible
+    {
+        vector<iovec> iov;
+        for (auto& b : bufs)
+            iov.push_back({const_cast<char*>(b.data()),b.size()}); // writev() doesn't write to the buffers
+        for (size_t i = 0; i!=iov.size(); ) {
+            int n = min(iov.size()-i,size_t{IOV_MAX});
+            ssize_t written = ::writev(fd,&iov[i],n);
+            if (written<0) {
+                if (errno==EINTR)
+                    continue;
+                throw system_error{errno,system_category(),"Output_sink"};
+            }
+            for (; i!=iov.size() && static_cast<size_t>(written)>=iov[i].iov_len; ++i) // skip what was completely written
+                written -= iov[i].iov_len;
+            if (i!=iov.size()) { // a partial write: continue in the middle of iov[i]
+                iov[i].iov_base = static_cast<char*>(iov[i].iov_base)+written;
+                iov[i].iov_len -= written;
+            }
+        }
+    }
+
+    void flush_loop(stop_token tok) // the background writer
+    {
+        unique_lock lck {mtx};
+        while (true) {
+            cv.wait(lck,[&] { return !full.empty() || tok.stop_requested(); });
+            if (full.empty()) // stop requested and nothing left to write
+                return;
+            vector<string> batch;
+            swap(batch,full);
+            writing = true;
+            lck.unlock();
+            try {
+                write_out(batch);
+            }
+            catch (const system_error& e) {
+                lck.lock();
+                error = e.code().value();
+                writing = false;
+                cv.notify_all();
+                continue;
+            }
+            lck.lock();
+            for (auto& b : batch) { // give the buffers back for reuse
+                b.clear();
+                spare.push_back(move(b));
+            }
+            writing = false;
+            cv.notify_all();
+        }
+    }
+
+    int fd;
+    size_t bufsz;
+    string cur; // being filled
+    vector<string> full; // filled, not yet written
+    vector<string> spare; // written, ready for reuse (background mode)
+    mutex mtx;
+    condition_variable cv;
+    bool writing = false;
+    int error = 0; // errno from the background writer
+    jthread flusher; // last: stopped and joined before the rest is destroyed
+};
+
+Output_sink& operator<<(Output_sink& os, string_view s) { os.write(s); return os; }
+Output_sink& operator<<(Output_sink& os, char c) { os.put(c); return os; }
+
+template<typename T>
+    requires is_arithmetic_v<T> && (!is_same_v<T,bool>)
+Output_sink& operator<<(Output_sink& os, T x) // numbers are formatted with to_chars(): no locale
+{
+    char buf[64];
+    auto [p,ec] = to_chars(buf,buf+sizeof(buf),x);
+    os.write({buf,static_cast<size_t>(p-buf)});
+    return os;
+}
+
+template<same_as<bool> B> // a template, so that a pointer (e.g., a string literal) doesn't convert to bool
+Output_sink& operator<<(Output_sink& os, B b) // there is no to_chars(bool); write 1 or 0, as cout does by default
+{
+    os.put(b ? '1' : '0');
+    return os;
+}
+
+// Like ostream_iterator, but for an Output_sink, so that code like copy(b,oo) needs no other change:
+template<typename T>
+class Sink_iterator {
+public:
+    using difference_type = ptrdiff_t;
+    Sink_iterator(Output_sink& s, string_view delim = "") : sink{&s}, d{delim} {}
+    Sink_iterator& operator=(const T& x)
+    {
+        *sink << x;
+        sink->write(d);
+        return *this;
+    }
+    Sink_iterator& operator*() { return *this; }
+    Sink_iterator& operator++() { return *this; }
+    Sink_iterator operator++(int) { return *this; }
+private:
+    Output_sink* sink;
+    string_view d; // the delimiter must outlive the iterator (a string literal is fine)
+};
+
+void report(const vector<string>& b, const vector<pair<string,double>>& prices)
+{
+    Output_sink out {1,true}; // standard output, written by a background thread
+    Sink_iterator<string> oo {out,"\n"};
+    copy(b,oo); // as with ostream_iterator
+    for (auto& [name,price] : prices)
+        format_to(out.out(),"{:<20}{:>10.2f}\n",name,price); // format straight into the buffer
+    out.flush();
+}
@@ -71,6 +71,104 @@ void f2() {
     auto x4 = to(1.2); // the <> is redundant. Target is defaulted to string; Source is deduced to double
 }
 
+// Each call of to<>() creates a stringstream, with its buffer and its locale, only to format a value and read it back.
+// Most uses convert between numbers and strings, and for those <charconv> offers to_chars() and from_chars():
+// no locale, no stream, no allocation. We can choose at compile time, keeping the stream version for all other types.
+// The contract is unchanged: leading and trailing whitespace is ignored, and anything else left over is an error.
+// One difference: a floating-point value is written with the fewest digits that read back as the same value
+// (1.0/3 becomes "0.3333333333333333", not the stream's "0.333333").
+// from_text() takes care to read what >> reads: a leading +, "-1" for an unsigned (giving its largest value),
+// but not "inf" or "nan".
+template<typename T>
+concept Number = is_arithmetic_v<T> && !is_same_v<T,bool> // streams write bool and the character types as text
+    && !is_same_v<T,char> && !is_same_v<T,signed char> && !is_same_v<T,unsigned char> && !is_same_v<T,wchar_t>
+    && !is_same_v<T,char8_t> && !is_same_v<T,char16_t> && !is_same_v<T,char32_t>;
+
+template<typename T>
+concept String_like = is_convertible_v<const T&,string_view>; // string, string_view, const char*, ...
+
+template<typename Target, typename Source>
+Target to_via_stream(const Source& arg) // the general version, as before
+{
+    stringstream buf;
+    Target result;
+    if (!(buf << arg) || !(buf >> result) || !(buf >> std::ws).eof())
+        throw runtime_error{"to<>() failed"};
+    return result;
+}
+
+string_view trim(string_view s)
+{
+    auto space = [](char c) { return isspace(static_cast<unsigned char>(c)); };
+    while (!s.empty() && space(s.front()))
+        s.remove_prefix(1);
+    while (!s.empty() && space(s.back()))
+        s.remove_suffix(1);
+    return s;
+}
+
+template<Number T>
+T from_text(string_view s)
+{
+    s = trim(s);
+    if (s.size()>1 && s[0]=='+' && s[1]!='-') // >> accepts a + sign; from_chars() doesn't
+        s.remove_prefix(1);
+    bool negate = false;
+    if constexpr (is_unsigned_v<T>) // >> reads "-n" into an unsigned as n negated (modulo 2^N): "-1" becomes the largest value
+        if (s.size()>1 && s[0]=='-') {
+            s.remove_prefix(1);
+            negate = true;
+        }
+    if constexpr (is_floating_point_v<T>) { // from_chars() also accepts "inf", "infinity", and "nan"; >> doesn't
+        string_view mantissa = s.substr(s.starts_with('-') ? 1 : 0);
+        if (!mantissa.empty() && !isdigit(static_cast<unsigned char>(mantissa[0])) && mantissa[0]!='.')
+            throw runtime_error{"to<>() failed"};
+    }
+    T result;
+    auto [p,ec] = from_chars(s.data(),s.data()+s.size(),result);
+    if constexpr (is_floating_point_v<T>)
+        if (ec==errc::result_out_of_range && p==s.data()+s.size()) { // too large, or too close to zero?
+            string tmp {s}; // >> uses strtod() here, which gives 0 (or a denormal) for a value too close to zero
+            long double x = strtold(tmp.c_str(),nullptr);
+            result = static_cast<T>(x);
+            if (!isinf(result))
+                return result;
+        }
+    if (ec!=errc{} || p!=s.data()+s.size() || s.empty()) // not a number, out of range, or something left over
+        throw runtime_error{"to<>() failed"};
+    return negate ? static_cast<T>(-result) : result;
+}
+
+template<typename Target =string, typename Source =string>
+Target to(Source arg) // convert Source to Target
+{
+    if constexpr (Number<Target> && String_like<Source>)
+        return from_text<Target>(arg);
+    else if constexpr (Number<Source> && (Number<Target> || is_same_v<Target,string>)) {
+        char buf[64]; // plenty for any arithmetic type
+        auto [p,ec] = to_chars(buf,buf+sizeof(buf),arg);
+        if constexpr (is_same_v<Target,string>)
+            return string(buf,p);
+        else
+            return from_text<Target>({buf,p}); // e.g., to<int>(1.5) fails because ".5" is left over
+    }
+    else if constexpr (is_same_v<Target,string> && String_like<Source>) { // >> reads a single word
+        string_view s = trim(arg);
+        if (s.empty() || ranges::any_of(s,[](char c) { return isspace(static_cast<unsigned char>(c)); }))
+            throw runtime_error{"to<>() failed"};
+        return string{s};
+    }
+    else
+        return to_via_stream<Target>(arg);
+}
+
+void f3(const string& field) {
+    auto n = to<int>(field); // from_chars(): no stringstream
+    auto d = to<double>(" 2.5 "); // surrounding whitespace is fine
+    auto s = to(n); // to_chars()
+    auto c = to<complex<double>>("(1,2)"); // no charconv support: uses a stringstream
+}
+
 // Memory Streams
 // An ospanstream behaves like an ostringstream and is initialized like it except that the
 // ospanstream takes a span rather than a string as an argument. For example:
@@ -102,4 +200,278 @@ void safer(int x, string& s)
     osyncstream oss(cout);
     oss << x;
     oss << s;
-}
\ No newline at end of file
+}
+// An osyncstream allocates a buffer of its own, and each emit() serializes on a lock shared with every other
+// osyncstream writing to the same stream. When many threads log, that (and the formatting) can cost more than the
+// work being logged. A Log_sink does less on the logging thread:
+// • each thread has a ring buffer of fixed-size records of its own; logging takes no lock and allocates nothing
+// • a record holds a timestamp, the source_location, and the raw values: numbers in binary, strings as bytes
+// • a single consumer thread drains the rings, merges the records in timestamp order, formats them, and writes
+//   them to a file descriptor through an Output_sink
+// A record that doesn't fit in a record's payload is truncated (and marked by "..."). When a thread's ring is full,
+// the thread waits for the consumer rather than dropping records.
+template<typename T>
+concept Loggable = is_arithmetic_v<T> || is_convertible_v<const T&,string_view>;
+
+class Log_sink {
+public:
+    struct Text { // the first argument of log(): a message and the location it is logged from
+        template<typename S>
+            requires is_convertible_v<const S&,string_view>
+        Text(const S& s, source_location l = source_location::current()) : text{s}, loc{l} {}
+        string_view text;
+        source_location loc;
+    };
+
+    explicit Log_sink(int file_descriptor = 2, size_t records_per_thread = 1024)
+        : out{file_descriptor}, ring_size{bit_ceil(max(records_per_thread,size_t{2}))}
+    {
+        consumer = jthread{[this](stop_token tok) { drain_loop(tok); }};
+    }
+    Log_sink(const Log_sink&) = delete;
+    Log_sink& operator=(const Log_sink&) = delete;
+    // ~Log_sink(): the consumer is stopped, writes whatever is left, and is joined;
+    // no thread may log to a Log_sink that is being destroyed
+
+    template<Loggable... Args>
+    void log(Text first, const Args&... args) // e.g., log("x = ",x," of ",name)
+    {
+        Ring& r = my_ring();
+        uint64_t h = r.head.load(memory_order_relaxed);
+        while (h-r.tail.load(memory_order_acquire)==r.records.size()) { // full: let the consumer catch up
+            if (!hurry.exchange(true))
+                wakeup.notify_one();
+            this_thread::yield();
+        }
+        Record& rec = r.records[h&r.mask];
+
+        // The consumer must not write a record newer than one we are about to publish, so it must be able to see
+        // that we are between reading the clock and publishing (see drain()):
+        r.pending.store(taking_time,memory_order_relaxed);
+        atomic_thread_fence(memory_order_seq_cst);
+        rec.time = now();
+        r.pending.store(rec.time,memory_order_relaxed);
+
+        rec.loc = first.loc;
+        rec.thread = r.index;
+        rec.size = 0;
+        rec.truncated = false;
+        encode(rec,first.text);
+        (encode(rec,args), ...);
+
+        r.head.store(h+1,memory_order_release);
+        r.pending.store(idle,memory_order_release);
+    }
+
+    void flush() // return once everything logged before the call has been written
+    {
+        uint64_t g;
+        {
+            scoped_lock lck {mtx};
+            g = ++flush_wanted;
+        }
+        wakeup.notify_all();
+        unique_lock lck {mtx};
+        flushed.wait(lck,[&] { return flush_done>=g; });
+        if (error)
+            throw system_error{exchange(error,0),system_category(),"Log_sink"};
+    }
+
+private:
+    enum class Kind : unsigned char { signed_int, unsigned_int, floating, boolean, character, text };
+    static constexpr size_t payload = 224; // bytes of values per record
+
+    struct alignas(64) Record {
+        int64_t time;
+        source_location loc;
+        uint16_t size; // bytes of data used
+        uint16_t thread;
+        bool truncated;
+        unsigned char data[payload];
+    };
+
+    static constexpr int64_t idle = 0; // values of Ring::pending that can't be timestamps
+    static constexpr int64_t taking_time = 1;
+
+    struct Ring { // single producer (the owning thread), single consumer
+        Ring(size_t n, int i) : records(n), mask{n-1}, index(i) {}
+        vector<Record> records;
+        size_t mask;
+        uint16_t index; // the thread's number in the output
+        alignas(64) atomic<uint64_t> head = 0; // written by the producer
+        atomic<int64_t> pending = idle; // idle, taking_time, or the time of the record being written
+        alignas(64) atomic<uint64_t> tail = 0; // written by the consumer
+    };
+
+    static int64_t now() { return chrono::steady_clock::now().time_since_epoch().count(); } // never 0 or 1 in practice
+
+    Ring& my_ring()
+    {
+        thread_local struct { uint64_t sink = 0; Ring* ring = nullptr; } cache; // for the most recently used sink
+        if (cache.sink!=id) {
+            scoped_lock lck {mtx};
+            Ring*& r = by_thread[this_thread::get_id()]; // a thread that has exited leaves its ring to a successor with the same id
+            if (!r) {
+                rings.push_back(make_unique<Ring>(ring_size,rings.size()));
+                r = rings.back().get();
+            }
+            cache = {id,r};
+        }
+        return *cache.ring;
+    }
+
+    static void put(Record& r, Kind k, const void* p, size_t n)
+    {
+        r.data[r.size++] = static_cast<unsigned char>(k);
+        memcpy(r.data+r.size,p,n);
+        r.size += n;
+    }
+
+    template<typename T>
+    static void encode(Record& r, const T& x) // no formatting here: just copy bytes
+    {
+        if constexpr (is_arithmetic_v<T>) {
+            if (size_t{r.size}+1+8>payload) {
+                r.truncated = true;
+                return;
+            }
+            if constexpr (is_same_v<T,bool>) put(r,Kind::boolean,&x,1);
+            else if constexpr (is_same_v<T,char>) put(r,Kind::character,&x,1);
+            else if constexpr (is_floating_point_v<T>) { double d = x; put(r,Kind::floating,&d,8); }
+            else if constexpr (is_signed_v<T>) { int64_t i = x; put(r,Kind::signed_int,&i,8); }
+            else { uint64_t u = x; put(r,Kind::unsigned_int,&u,8); }
+        }
+        else {
+            string_view s = x;
+            if (size_t{r.size}+1+2>=payload) {
+                r.truncated = r.truncated || !s.empty();
+                return;
+            }
+            uint16_t n = min(s.size(),payload-r.size-3); // < payload, so it fits
+            r.truncated = r.truncated || n<s.size();
+            put(r,Kind::text,&n,2);
+            memcpy(r.data+r.size,s.data(),n);
+            r.size += n;
+        }
+    }
+
+    void emit(const Record& r) // format a record; this is where the time goes, on the consumer's thread
+    {
+        auto since_start = chrono::duration_cast<chrono::microseconds>(chrono::steady_clock::duration{r.time-start});
+        out << since_start.count() << "us T" << r.thread << ' ' << r.loc.file_name()
+            << '(' << r.loc.line() << ':' << r.loc.column() << ") " << r.loc.function_name() << ": ";
+        for (size_t i = 0; i<r.size; ) {
+            Kind k = static_cast<Kind>(r.data[i++]);
+            auto get = [&]<typename T>(T x) { memcpy(&x,r.data+i,sizeof(x)); i += sizeof(x); return x; };
+            switch (k) {
+            case Kind::signed_int: out << get(int64_t{}); break;
+            case Kind::unsigned_int: out << get(uint64_t{}); break;
+            case Kind::floating: out << get(double{}); break;
+            case Kind::boolean: out << (get(bool{}) ? '1' : '0'); break; // as cout does by default
+            case Kind::character: out << get(char{}); break;
+            case Kind::text: {
+                uint16_t n = get(uint16_t{});
+                out << string_view{reinterpret_cast<const char*>(r.data+i),n};
+                i += n;
+                break;
+            }
+            }
+        }
+        if (r.truncated)
+            out << "...";
+        out << '\n';
+    }
+
+    // Move what the rings hold to held, then write, in time order, the held records that are older than
+    // anything that can still be logged. A record can still be logged with a time earlier than now()
+    // only by a thread that is in the middle of log(); its pending tells us how early.
+    // Return the time up to which everything has been written.
+    int64_t drain(bool all)
+    {
+        int64_t limit = all ? numeric_limits<int64_t>::max() : now();
+        atomic_thread_fence(memory_order_seq_cst); // pairs with the fence in log()
+        vector<Ring*> rs; // after reading the clock: a ring created later can only hold records from after limit
+        {
+            scoped_lock lck {mtx};
+            for (auto& p : rings)
+                rs.push_back(p.get());
+        }
+        for (Ring* r : rs) {
+            int64_t p;
+            while ((p = r->pending.load(memory_order_acquire))==taking_time) // a matter of a few instructions
+                this_thread::yield();
+            if (p!=idle)
+                limit = min(limit,p);
+            uint64_t t = r->tail.load(memory_order_relaxed);
+            uint64_t h = r->head.load(memory_order_acquire);
+            for (; t!=h; ++t)
+                held.push_back(r->records[t&r->mask]);
+            r->tail.store(t,memory_order_release);
+        }
+        ranges::stable_sort(held,{},&Record::time); // a ring's records are already in order; stable keeps equal times that way
+        auto last = ranges::lower_bound(held,limit,{},&Record::time);
+        for (auto p = held.begin(); p!=last; ++p)
+            emit(*p);
+        if (last!=held.begin()) {
+            held.erase(held.begin(),last);
+            out.flush();
+        }
+        return limit;
+    }
+
+    void drain_loop(stop_token tok)
+    {
+        unique_lock lck {mtx};
+        while (true) {
+            bool stopping = tok.stop_requested();
+            uint64_t g = flush_wanted;
+            lck.unlock();
+            int64_t asked = now(); // everything logged before the flush request is older than this
+            int64_t reached = asked;
+            try {
+                reached = drain(stopping);
+            }
+            catch (const system_error& e) { // keep going; report to the next flush()
+                held.clear();
+                lck.lock();
+                error = e.code().value();
+                lck.unlock();
+            }
+            lck.lock();
+            if (reached>=asked && flush_done!=g) {
+                flush_done = g;
+                flushed.notify_all();
+            }
+            if (stopping)
+                return;
+            if (flush_done==flush_wanted) // else, someone is waiting: go around again at once
+                wakeup.wait_for(lck,tok,poll,[&] { return hurry.load() || flush_wanted!=flush_done; });
+            hurry = false;
+        }
+    }
+
+    static constexpr chrono::milliseconds poll {1};
+    static inline atomic<uint64_t> next_id = 1;
+
+    const uint64_t id = next_id++; // identifies this sink in the per-thread cache
+    Output_sink out; // used by the consumer only
+    const size_t ring_size;
+    const int64_t start = now();
+    vector<Record> held; // drained, but not yet written (consumer only)
+    mutex mtx; // for rings, by_thread, flush_wanted, flush_done, and error
+    vector<unique_ptr<Ring>> rings;
+    map<thread::id,Ring*> by_thread;
+    uint64_t flush_wanted = 0;
+    uint64_t flush_done = 0;
+    int error = 0;
+    atomic<bool> hurry = false; // a producer's ring is full
+    condition_variable_any wakeup;
+    condition_variable flushed;
+    jthread consumer; // last: stopped and joined before the rest is destroyed
+};
+
+// With a Log_sink, safer() becomes:
+void safer2(Log_sink& log, int x, string& s)
+{
+    log.log("",x,s); // x and s are copied into this thread's ring, and written as one line
+}
@@ -28,3 +28,187 @@ void f(const Entry& ee, list<Entry>::iterator p, list<Entry>::iterator q) {
     phone_book.erase(q); // remove the element referred to by q
 }
 
+
+// Like vector, list takes an allocator argument, so a phone_book that lives only for the duration of
+// a request can take all its memory from an Arena (§12.2) and be thrown away in one step.
+// Entry holds a string, so to have the names in the arena too, Entry must accept an allocator:
+struct Pmr_entry {
+    using allocator_type = pmr::polymorphic_allocator<>; // tells the container to pass its allocator on
+    pmr::string name;
+    int number;
+
+    Pmr_entry(const Entry& e, allocator_type a = {}) : name{e.name,a}, number{e.number} {}
+    Pmr_entry(const Pmr_entry& e, allocator_type a = {}) : name{e.name,a}, number{e.number} {}
+};
+
+void snapshots(const list<Entry>& master)
+{
+    Arena arena; // one per thread: no locking and no contention on the free store
+    while (more_requests()) {
+        {
+            pmr::list<Pmr_entry> snapshot {&arena}; // nodes and names come from arena
+            for (const auto& e : master)
+                snapshot.emplace_back(e);
+            serve(snapshot);
+        } // destroying the snapshot frees nothing ...
+        arena.reset(); // ... the arena reclaims it all at once
+    }
+}
+
+// get_number() looks at every Entry until it finds the name, following a pointer from list node to list node.
+// For a large phone book, we need an index: a hash table mapping a name to where its Entry is.
+// A Phone_book keeps its Entries contiguously in a vector (good for iteration and for the cache) and indexes them with
+// an 'open addressing' hash table: a single array of entry indices, where a collision is resolved by trying the next slot.
+// Because entries move when others are erased, users hold a Handle rather than an iterator or a pointer;
+// a Handle stays valid until its own Entry is erased, and using it after that is detected.
+class Phone_book {
+public:
+    struct Handle {
+        uint32_t slot = 0;
+        uint32_t gen = 0; // generation: distinguishes reuses of the same slot
+        bool operator==(const Handle&) const = default;
+    };
+
+    pair<Handle,bool> insert(const Entry& e) // false if the name is already present (then nothing is inserted)
+    {
+        size_t h = hash<string_view>{}(e.name);
+        if (auto i = lookup(e.name,h))
+            return {handle_of(*i),false};
+        if ((entries.size()+1)*4>table.size()*3) // keep the table at most 3/4 full
+            rehash(max<size_t>(16,table.size()*2));
+        uint32_t ei = entries.size();
+        entries.push_back(e);
+        hashes.push_back(h);
+        place(ei);
+        uint32_t s;
+        if (free_slots.empty()) {
+            s = slots.size();
+            slots.push_back({ei,0});
+        }
+        else {
+            s = free_slots.back();
+            free_slots.pop_back();
+            slots[s].entry = ei;
+        }
+        entry_slot.push_back(s);
+        return {{s,slots[s].gen},true};
+    }
+
+    optional<Handle> find(string_view name) const // string_view: looking up a const char* or a substring creates no string
+    {
+        if (auto i = lookup(name,hash<string_view>{}(name)))
+            return handle_of(*i);
+        return {};
+    }
+
+    int get_number(string_view name) const
+    {
+        auto i = lookup(name,hash<string_view>{}(name));
+        return i ? entries[*i].number : 0; // use 0 to represent "number not found"
+    }
+
+    const Entry& operator[](Handle h) const { return entries[index_of(h)]; }
+    void set_number(Handle h, int n) { entries[index_of(h)].number = n; } // the name is the key: it can't be changed in place
+
+    void erase(Handle h)
+    {
+        uint32_t ei = index_of(h);
+        unplace(ei);
+        ++slots[h.slot].gen; // outstanding copies of h are now stale
+        free_slots.push_back(h.slot);
+        uint32_t last = entries.size()-1;
+        if (ei!=last) { // keep the entries contiguous: move the last entry into the hole
+            unplace(last);
+            entries[ei] = move(entries[last]);
+            hashes[ei] = hashes[last];
+            entry_slot[ei] = entry_slot[last];
+            slots[entry_slot[ei]].entry = ei;
+            place(ei);
+        }
+        entries.pop_back();
+        hashes.pop_back();
+        entry_slot.pop_back();
+    }
+
+    size_t size() const { return entries.size(); }
+    auto begin() const { return entries.cbegin(); } // in no particular order
+    auto end() const { return entries.cend(); }
+
+private:
+    static constexpr uint32_t empty = numeric_limits<uint32_t>::max();
+
+    struct Slot {
+        uint32_t entry; // index into entries
+        uint32_t gen;
+    };
+
+    size_t mask() const { return table.size()-1; }
+
+    optional<uint32_t> lookup(string_view name, size_t h) const
+    {
+        if (table.empty())
+            return {};
+        for (size_t i = h&mask(); table[i]!=empty; i = (i+1)&mask()) {
+            uint32_t ei = table[i];
+            if (hashes[ei]==h && entries[ei].name==name) // compare the full hashes first: usually avoids the string compare
+                return ei;
+        }
+        return {};
+    }
+
+    void place(uint32_t ei) // enter entries[ei] in the index
+    {
+        size_t i = hashes[ei]&mask();
+        while (table[i]!=empty)
+            i = (i+1)&mask();
+        table[i] = ei;
+    }
+
+    void unplace(uint32_t ei) // remove entries[ei] from the index
+    {
+        size_t i = hashes[ei]&mask();
+        while (table[i]!=ei)
+            i = (i+1)&mask();
+        // Shift later members of the probe sequence back, so that no 'deleted' markers are needed:
+        for (size_t j = (i+1)&mask(); table[j]!=empty; j = (j+1)&mask()) {
+            size_t home = hashes[table[j]]&mask();
+            if (((j-home)&mask())>=((j-i)&mask())) { // table[j] may move to i without passing its home slot
+                table[i] = table[j];
+                i = j;
+            }
+        }
+        table[i] = empty;
+    }
+
+    void rehash(size_t n) // n is a power of 2
+    {
+        table.assign(n,empty);
+        for (uint32_t ei = 0; ei!=entries.size(); ++ei)
+            place(ei);
+    }
+
+    uint32_t index_of(Handle h) const
+    {
+        if (h.slot>=slots.size() || slots[h.slot].gen!=h.gen)
+            throw out_of_range{"Phone_book: stale handle"};
+        return slots[h.slot].entry;
+    }
+    Handle handle_of(uint32_t ei) const { return {entry_slot[ei],slots[entry_slot[ei]].gen}; }
+
+    vector<Entry> entries; // contiguous
+    vector<size_t> hashes; // hashes[i] is the hash of entries[i].name
+    vector<uint32_t> entry_slot; // entry_slot[i] is the slot referring to entries[i]
+    vector<Slot> slots; // what Handles refer to
+    vector<uint32_t> free_slots;
+    vector<uint32_t> table; // the index: entry indices, or empty
+};
+
+// A lookup is now a hash computation and (usually) one or two probes:
+void f2(Phone_book& book)
+{
+    book.insert({"David Hume",123456});
+    auto [h,inserted] = book.insert({"Karl Popper",234567});
+    cout << book.get_number("David Hume") << '\n'; // no string is created for the argument
+    book.set_number(h,345678);
+    book.erase(h); // h is now stale
+}
@@ -24,3 +24,228 @@ namespace std { // make a hash function for Record
     };
 }
 
+
+// Combining hashes with ˆ has two problems: it is symmetric (swapping two values of the same type gives the same hash),
+// and equal parts cancel (hash(x)ˆhash(x)==0). A better way is to mix each new hash into the previous result
+// in an order-dependent way:
+inline void hash_combine(size_t& seed, size_t h)
+{
+    seed ^= h+0x9e3779b97f4a7c15+(seed<<12)+(seed>>4); // 0x9e37... is 2^64 divided by the golden ratio: 'random' bits
+}
+
+template<typename... Ts>
+size_t hash_values(const Ts&... xs) // combine the hashes of xs in order
+{
+    size_t seed = 0;
+    (hash_combine(seed,hash<Ts>{}(xs)),...);
+    return seed;
+}
+
+struct Rhash2 { // a hash function for Record
+    size_t operator()(const Record& r) const { return hash_values(r.name,r.product_code); }
+};
+
+// An unordered_set stores each element in a separately allocated node, so a lookup typically follows two or three
+// pointers, each a potential cache miss. A 'flat' hash table stores the elements themselves in one array.
+// Flat_table keeps, next to the elements, one control byte per slot: 'empty,' 'deleted,' or 7 bits of the element's hash.
+// A lookup compares 16 control bytes at once with a single SSE2 instruction and looks at an element only if its 7 bits
+// match, so most lookups touch one group of control bytes and one element (the design of Google's 'Swiss tables').
+template<typename Value, typename Key, typename Key_of, typename Hash, typename Eq>
+class Flat_table {
+public:
+    Flat_table() = default;
+    Flat_table(const Flat_table&) = delete; // keep the example short
+    Flat_table& operator=(const Flat_table&) = delete;
+    ~Flat_table() { clear(); }
+
+    template<typename V>
+    pair<Value*,bool> insert(V&& v) // false if an element with the same key is already present
+    {
+        const Key& k = Key_of{}(v);
+        size_t h = mix(Hash{}(k));
+        if (Value* p = find(k,h))
+            return {p,false};
+        if ((count+deleted+1)*8>cap*7) // keep at most 7/8 of the slots in use
+            rehash(cap==0 ? group : (count*2>=cap/2 ? cap*2 : cap)); // grow, or just clear out deleted slots
+        size_t i = free_slot(h);
+        if (ctrl[i]==deleted_slot)
+            --deleted;
+        ctrl[i] = h2(h);
+        Value* p = construct_at(slot(i),std::forward<V>(v));
+        ++count;
+        return {p,true};
+    }
+
+    Value* find(const Key& k) { return find(k,mix(Hash{}(k))); }
+    bool contains(const Key& k) { return find(k)!=nullptr; }
+
+    bool erase(const Key& k)
+    {
+        Value* p = find(k);
+        if (!p)
+            return false;
+        size_t i = p-slot(0);
+        destroy_at(p);
+        ctrl[i] = deleted_slot; // a marker, so that probe sequences passing through this slot aren't cut short
+        --count;
+        ++deleted;
+        return true;
+    }
+
+    void clear()
+    {
+        for (size_t i = 0; i!=cap; ++i)
+            if (is_full(ctrl[i]))
+                destroy_at(slot(i));
+        fill_n(ctrl.get(),cap,empty_slot);
+        count = deleted = 0;
+    }
+
+    size_t size() const { return count; }
+
+    template<typename F>
+    void for_each(F f) // apply f to each element, in no particular order
+    {
+        for (size_t i = 0; i!=cap; ++i)
+            if (is_full(ctrl[i]))
+                f(*slot(i));
+    }
+
+private:
+    static constexpr size_t group = 16;
+    static constexpr int8_t empty_slot = -128; // 0b10000000
+    static constexpr int8_t deleted_slot = -2; // 0b11111110
+    static bool is_full(int8_t c) { return c>=0; } // full slots hold 7 bits of hash, so their high bit is 0
+
+    static size_t mix(size_t h) // hash<int> is often the identity; spread the bits so that the top 7 bits and the low bits both vary
+    {
+        h ^= h>>33;
+        h *= 0xff51afd7ed558ccd;
+        h ^= h>>33;
+        return h;
+    }
+    static int8_t h2(size_t h) { return static_cast<int8_t>(h>>57); } // the top 7 bits, stored in the control byte
+    size_t h1(size_t h) const { return (h>>7)&(cap/group-1); } // the first group to look in
+
+    static uint32_t match(const int8_t* g, int8_t c) // bit i set if g[i]==c
+    {
+#if defined(__SSE2__)
+        __m128i x = _mm_loadu_si128(reinterpret_cast<const __m128i*>(g));
+        return _mm_movemask_epi8(_mm_cmpeq_epi8(x,_mm_set1_epi8(c)));
+#else
+        uint32_t m = 0;
+        for (size_t i = 0; i!=group; ++i)
+            m |= uint32_t(g[i]==c)<<i;
+        return m;
+#endif
+    }
+
+    Value* find(const Key& k, size_t h)
+    {
+        if (cap==0)
+            return nullptr;
+        size_t ngroups = cap/group;
+        for (size_t g = h1(h), step = 1; ; g = (g+step++)&(ngroups-1)) { // quadratic probing over groups
+            const int8_t* c = ctrl.get()+g*group;
+            for (uint32_t m = match(c,h2(h)); m; m &= m-1) {
+                size_t i = g*group+countr_zero(m);
+                if (Eq{}(Key_of{}(*slot(i)),k))
+                    return slot(i);
+            }
+            if (match(c,empty_slot)) // an empty slot ends the probe sequence: k isn't here
+                return nullptr;
+            if (step>ngroups) // (can't happen while the table has empty slots)
+                return nullptr;
+        }
+    }
+
+    size_t free_slot(size_t h) const // the first empty or deleted slot along h's probe sequence
+    {
+        size_t ngroups = cap/group;
+        for (size_t g = h1(h), step = 1; ; g = (g+step++)&(ngroups-1)) {
+            const int8_t* c = ctrl.get()+g*group;
+            if (uint32_t m = match(c,empty_slot)|match(c,deleted_slot))
+                return g*group+countr_zero(m);
+        }
+    }
+
+    void rehash(size_t newcap)
+    {
+        auto old_ctrl = move(ctrl);
+        auto old_slots = move(slots);
+        size_t old_cap = cap;
+        ctrl = make_unique<int8_t[]>(newcap);
+        fill_n(ctrl.get(),newcap,empty_slot);
+        slots = make_unique<Storage[]>(newcap);
+        cap = newcap;
+        deleted = 0;
+        for (size_t i = 0; i!=old_cap; ++i)
+            if (is_full(old_ctrl[i])) {
+                Value* p = reinterpret_cast<Value*>(&old_slots[i]);
+                size_t h = mix(Hash{}(Key_of{}(*p)));
+                size_t j = free_slot(h);
+                ctrl[j] = h2(h);
+                construct_at(slot(j),move(*p));
+                destroy_at(p);
+            }
+    }
+
+    struct Storage {
+        alignas(Value) unsigned char b[sizeof(Value)];
+    };
+    Value* slot(size_t i) { return reinterpret_cast<Value*>(&slots[i]); }
+
+    unique_ptr<int8_t[]> ctrl; // cap control bytes
+    unique_ptr<Storage[]> slots; // cap slots, constructed only where ctrl says 'full'
+    size_t cap = 0; // a power of 2, at least group
+    size_t count = 0;
+    size_t deleted = 0;
+};
+
+struct Identity {
+    template<typename T>
+    const T& operator()(const T& x) const { return x; }
+};
+struct First {
+    template<typename P>
+    const auto& operator()(const P& p) const { return p.first; }
+};
+
+template<typename T, typename Hash = hash<T>, typename Eq = equal_to<T>>
+using Flat_set = Flat_table<T,T,Identity,Hash,Eq>;
+
+template<typename K, typename V, typename Hash = hash<K>, typename Eq = equal_to<K>>
+class Flat_map : public Flat_table<pair<const K,V>,K,First,Hash,Eq> {
+public:
+    V& operator[](const K& k) { return this->insert(pair<const K,V>{k,V{}}).first->second; }
+};
+
+Flat_set<Record,Rhash2> my_flat_set; // used like my_set, but without nodes
+Flat_map<string,Record> by_name;
+
+// Measure before believing: a simple comparison of lookups in unordered_set and Flat_set
+void bench_lookup(int n)
+{
+    vector<Record> recs;
+    for (int i = 0; i!=n; ++i)
+        recs.push_back({"product"+to_string(i),i});
+    unordered_set<Record,Rhash2> us;
+    Flat_set<Record,Rhash2> fs;
+    for (auto& r : recs) {
+        us.insert(r);
+        fs.insert(r);
+    }
+    shuffle(recs.begin(),recs.end(),mt19937{42}); // look up in random order, as in real use
+
+    auto time = [&](const char* name, auto lookup) {
+        auto t0 = chrono::steady_clock::now();
+        int found = 0;
+        for (int rep = 0; rep!=10; ++rep)
+            for (auto& r : recs)
+                found += lookup(r);
+        auto t1 = chrono::steady_clock::now();
+        cout << name << ": " << chrono::duration<double,nano>(t1-t0).count()/(10.0*n) << " ns per lookup (" << found << " found)\n";
+    };
+    time("unordered_set",[&](const Record& r) { return us.contains(r); });
+    time("Flat_set",[&](const Record& r) { return fs.contains(r); });
+}
@@ -99,3 +99,363 @@ void checked(Vec<Entry>& book) {
     }
 }
 
+
+// The doubling in push_back() is a good default, but not the only sensible one:
+// • a factor of 1.5 wastes less space and lets freed blocks be reused by later growth
+// • rounding up to whole pages suits very large vectors
+// • many vectors never hold more than a few elements, so keeping those in the object itself
+//   (the "small buffer optimization") avoids the free store altogether
+// We can make the growth strategy a template argument:
+struct Grow_double { // the growth policy of Vector<T> above
+    static size_t next(size_t cap) { return cap==0 ? 8 : 2*cap; }
+};
+struct Grow_one_and_a_half {
+    static size_t next(size_t cap) { return cap<4 ? 8 : cap+cap/2; }
+};
+template<typename T>
+struct Grow_pages { // grow by doubling, but always to a whole number of 4K pages
+    static size_t next(size_t cap)
+    {
+        constexpr size_t page = 4096;
+        size_t bytes = (cap==0 ? 1 : 2*cap)*sizeof(T);
+        bytes = (bytes+page-1)/page*page;
+        return bytes/sizeof(T);
+    }
+};
+
+// When moving elements to a new buffer, a type that can be relocated by copying its bytes
+// (e.g., int, double, or a struct of those) is best moved with a single memcpy().
+// The standard library doesn't (yet) have a name for "trivially relocatable," so we use the
+// conservative approximation "trivially copyable":
+template<typename T>
+constexpr bool trivially_relocatable = is_trivially_copyable_v<T>;
+
+// A Small_vector<T,N> holds up to N elements inside the object and uses the free store only beyond that:
+template<typename T, size_t N = 16, typename Growth = Grow_one_and_a_half>
+class Small_vector {
+public:
+    Small_vector() = default;
+    Small_vector(initializer_list<T> lst)
+    {
+        reserve(lst.size());
+        for (const T& x : lst)
+            push_back(x);
+    }
+    Small_vector(const Small_vector& a)
+    {
+        reserve(a.size());
+        for (const T& x : a)
+            push_back(x);
+    }
+    Small_vector(Small_vector&& a) noexcept { take(a); }
+    Small_vector& operator=(const Small_vector& a)
+    {
+        if (this != &a) {
+            clear();
+            reserve(a.size());
+            for (const T& x : a)
+                push_back(x);
+        }
+        return *this;
+    }
+    Small_vector& operator=(Small_vector&& a) noexcept
+    {
+        if (this != &a) {
+            clear();
+            release();
+            take(a);
+        }
+        return *this;
+    }
+    ~Small_vector()
+    {
+        clear();
+        release();
+    }
+
+    T& operator[](size_t i) { return elem[i]; }
+    const T& operator[](size_t i) const { return elem[i]; }
+    size_t size() const { return sz; }
+    size_t capacity() const { return cap; }
+    bool on_heap() const { return elem != inline_buf(); } // have we outgrown the inline buffer?
+
+    T* begin() { return elem; }
+    T* end() { return elem+sz; }
+    const T* begin() const { return elem; }
+    const T* end() const { return elem+sz; }
+
+    void reserve(size_t newcap) // increase capacity() to at least newcap
+    {
+        if (newcap <= cap)
+            return;
+        reallocate(newcap);
+    }
+
+    void shrink_to_fit() // give back unused capacity; moves the elements back inline if they fit
+    {
+        if (!on_heap() || sz == cap)
+            return;
+        reallocate(sz);
+    }
+
+    void push_back(const T& t) { emplace_back(t); }
+    void push_back(T&& t) { emplace_back(std::move(t)); }
+
+    template<typename... Args>
+    T& emplace_back(Args&&... args)
+    {
+        if (sz < cap) {
+            T* p = construct_at(elem+sz, std::forward<Args>(args)...);
+            ++sz;
+            return *p;
+        }
+        // Full: construct the new element in the new buffer before moving the old ones out, so that
+        // an argument referring into this vector (e.g., v.push_back(v[0])) is still intact when it is read
+        size_t newcap = max(Growth::next(cap), sz+1); // > N, so on the heap
+        T* p = alloc.allocate(newcap);
+        try {
+            construct_at(p+sz, std::forward<Args>(args)...);
+        }
+        catch (...) {
+            alloc.deallocate(p, newcap);
+            throw;
+        }
+        relocate(elem, sz, p);
+        release();
+        elem = p;
+        cap = newcap;
+        return elem[sz++];
+    }
+
+    void clear()
+    {
+        destroy(elem, elem+sz);
+        sz = 0;
+    }
+
+private:
+    T* inline_buf() { return reinterpret_cast<T*>(buf); }
+    const T* inline_buf() const { return reinterpret_cast<const T*>(buf); }
+
+    void take(Small_vector& a) // move a's elements into the empty *this
+    {
+        if (a.on_heap()) { // steal a's buffer
+            elem = a.elem;
+            cap = a.cap;
+            a.elem = a.inline_buf();
+            a.cap = N;
+        }
+        else // the elements live inside a; they must be moved one by one
+            relocate(a.elem, a.sz, elem);
+        sz = a.sz;
+        a.sz = 0;
+    }
+
+    static void relocate(T* from, size_t n, T* to) // move n elements from 'from' to 'to' and destroy the originals
+    {
+        if constexpr (trivially_relocatable<T>) {
+            if (n)
+                memcpy(static_cast<void*>(to), from, n*sizeof(T));
+        }
+        else {
+            uninitialized_move(from, from+n, to);
+            destroy(from, from+n);
+        }
+    }
+
+    void reallocate(size_t newcap) // precondition: sz<=newcap
+    {
+        T* p = newcap<=N ? inline_buf() : alloc.allocate(newcap);
+        if (p == elem) // already inline and staying inline
+            return;
+        relocate(elem, sz, p);
+        release();
+        elem = p;
+        cap = newcap<=N ? N : newcap;
+    }
+
+    void release() // give back the heap buffer, if any
+    {
+        if (on_heap())
+            alloc.deallocate(elem, cap);
+        elem = inline_buf();
+        cap = N;
+    }
+
+    alignas(T) unsigned char buf[N*sizeof(T)]; // room for N Ts, constructed only when used
+    allocator<T> alloc;
+    T* elem = inline_buf(); // either buf or memory from alloc
+    size_t sz = 0;
+    size_t cap = N;
+};
+
+// A Small_vector is used exactly like a Vector; only the performance differs:
+void small_user()
+{
+    Small_vector<Entry,16> hits; // fits most results: no allocation
+    for (const auto& e : phone_book)
+        if (e.number<200000)
+            hits.push_back(e);
+    Small_vector<int,4,Grow_pages<int>> big; // grows in whole pages once past 4 elements
+    for (int i = 0; i!=100'000; ++i)
+        big.push_back(i);
+    big.shrink_to_fit();
+}
+
+// Vector<T> above always gets its memory from allocator<T>, that is, from the free store.
+// The standard containers take the allocator as a template argument, and so can Vector:
+template<typename T, typename A = allocator<T>>
+class Vector {
+    A alloc; // where the elements come from
+    T* elem = nullptr;
+    T* space = nullptr;
+    T* last = nullptr;
+    using traits = allocator_traits<A>;
+public:
+    using allocator_type = A;
+    Vector() = default;
+    explicit Vector(const A& a) : alloc{a} {}
+    ~Vector()
+    {
+        for (T* p = elem; p!=space; ++p)
+            traits::destroy(alloc,p);
+        if (elem)
+            traits::deallocate(alloc,elem,capacity());
+    }
+    // ... copy and move ...
+    int size() const { return space-elem; }
+    int capacity() const { return last-elem; }
+    T& operator[](int i) { return elem[i]; }
+    allocator_type get_allocator() const { return alloc; }
+
+    void reserve(int newsz)
+    {
+        if (newsz<=capacity())
+            return;
+        T* p = traits::allocate(alloc,newsz);
+        int n = size();
+        for (int i = 0; i!=n; ++i) { // move the elements into the new space
+            traits::construct(alloc,p+i,std::move(elem[i]));
+            traits::destroy(alloc,elem+i);
+        }
+        if (elem)
+            traits::deallocate(alloc,elem,capacity());
+        elem = p;
+        space = p+n;
+        last = p+newsz;
+    }
+
+    void push_back(const T& t)
+    {
+        if (capacity()<=size())
+            reserve(size()==0?8:2*size());
+        traits::construct(alloc,space,t); // for a pmr allocator, this also passes the allocator on to t's members
+        ++space;
+    }
+
+    template<typename... Args>
+    T& emplace_back(Args&&... args) // construct the element in place, from args
+    {
+        if (capacity()<=size())
+            reserve(size()==0?8:2*size());
+        traits::construct(alloc,space,std::forward<Args>(args)...); // e.g., a pmr::string gets its characters from our allocator directly
+        return *space++;
+    }
+};
+
+// With pmr::polymorphic_allocator (from <memory_resource>), the choice of memory is made at run time by passing
+// a memory_resource, and Vectors using different resources still have the same type:
+template<typename T>
+using Pmr_vector = Vector<T,pmr::polymorphic_allocator<T>>;
+
+// An Arena is a memory_resource that hands out memory by simply bumping a pointer through large chunks.
+// Deallocating an individual object does nothing; instead, reset() makes all the memory available again at once.
+// The chunks are kept for reuse, so a program that repeatedly fills and resets an arena soon stops calling the
+// free store altogether. An Arena is not synchronized: give each thread its own.
+class Arena : public pmr::memory_resource {
+public:
+    explicit Arena(size_t chunk_size = 64*1024, pmr::memory_resource* up = pmr::new_delete_resource())
+        : chunk_sz{chunk_size}, upstream{up} {}
+    Arena(const Arena&) = delete;
+    Arena& operator=(const Arena&) = delete;
+    ~Arena()
+    {
+        for (auto& c : chunks)
+            upstream->deallocate(c.mem,c.size,alignof(max_align_t));
+    }
+
+    void reset() // "free" everything allocated from this arena; every object using it must already be gone
+    {
+        cur = 0;
+        if (!chunks.empty()) {
+            next = chunks[0].mem;
+            end = next+chunks[0].size;
+        }
+    }
+
+    size_t reserved() const // bytes held from the upstream resource
+    {
+        size_t n = 0;
+        for (auto& c : chunks)
+            n += c.size;
+        return n;
+    }
+
+private:
+    struct Chunk {
+        byte* mem;
+        size_t size;
+    };
+
+    void* do_allocate(size_t n, size_t align) override
+    {
+        for (;;) {
+            if (next) {
+                auto p = reinterpret_cast<uintptr_t>(next);
+                auto aligned = (p+align-1) & ~uintptr_t(align-1);
+                if (aligned+n <= reinterpret_cast<uintptr_t>(end)) { // fits in the current chunk
+                    next = reinterpret_cast<byte*>(aligned+n);
+                    return reinterpret_cast<void*>(aligned);
+                }
+            }
+            advance(n+align);
+        }
+    }
+
+    void advance(size_t need) // move on to a chunk with at least need bytes, reusing old chunks where possible
+    {
+        size_t i = next ? cur+1 : cur;
+        if (i==chunks.size() || chunks[i].size<need) {
+            size_t sz = max(chunk_sz,need);
+            chunks.insert(chunks.begin()+i, Chunk{static_cast<byte*>(upstream->allocate(sz,alignof(max_align_t))), sz});
+        }
+        cur = i;
+        next = chunks[i].mem;
+        end = next+chunks[i].size;
+    }
+
+    void do_deallocate(void*, size_t, size_t) override {} // memory is reclaimed only by reset()
+    bool do_is_equal(const pmr::memory_resource& other) const noexcept override { return this==&other; }
+
+    size_t chunk_sz;
+    pmr::memory_resource* upstream;
+    vector<Chunk> chunks;
+    size_t cur = 0; // index of the chunk we are allocating from
+    byte* next = nullptr; // first free byte in chunks[cur]
+    byte* end = nullptr; // one beyond the last byte of chunks[cur]
+};
+
+// Using an Arena, a Vector and all the strings it holds are freed in one step:
+void arena_user(const vector<Entry>& book)
+{
+    Arena arena;
+    for (int request = 0; request!=1000; ++request) {
+        {
+            Pmr_vector<pmr::string> names {&arena}; // elements get their memory from arena, and so do the strings' characters
+            for (const auto& e : book)
+                names.emplace_back(e.name); // not push_back(pmr::string{e.name}): that would first build a string on the free store
+            // ... use names ...
+        } // names is destroyed: its deallocations are no-ops
+        arena.reset(); // O(1): all the memory is ready for the next request
+    }
+}
@@ -48,3 +48,305 @@ int main() {
     return !is.eof() || !os; // return error state
 }
 
+
+// The words need not be copied into strings at all if the input file is mapped into memory (Input_source, §11.9).
+// The vector then holds string_views referring to the file's characters:
+int main() {
+    string from, to;
+    cin >> from >> to; // get source and target file names
+    Input_source in {path{from}}; // mapped if possible
+    string_view text = in.all(); // the whole file; stays valid as long as in
+    vector<string_view> b;
+    Input_source words {text};
+    ranges::copy(words.words(),back_inserter(b)); // no per-word allocation
+    ofstream os {to};
+    ostream_iterator<string_view> oo {os,"\n"};
+    ranges::sort(b);
+    ranges::unique_copy(b,oo);
+    return !os;
+}
+
+// Both versions need all the words in memory at once. For inputs larger than memory, we can sort in pieces:
+// • read as many words as fit in a memory budget, sort them, remove duplicates, and write them to a temporary file (a 'run')
+// • repeat until the input is exhausted; the runs are independent, so several can be sorted concurrently
+// • merge the sorted runs, always writing the smallest of the runs' current words and skipping repeats
+class Temp_file { // a file that removes itself
+public:
+    Temp_file()
+    {
+        // A predictable name in a shared directory could be taken first by someone else (e.g., as a symbolic link),
+        // so let mkstemp() pick a fresh name and create the file exclusively, readable by us only:
+        string name = (temp_directory_path()/("run-"+to_string(::getpid())+"-XXXXXX")).string();
+        int fd = ::mkstemp(name.data());
+        if (fd<0)
+            throw system_error{errno,system_category(),"can't create a temporary file"};
+        ::close(fd); // the file is ours now; it is reopened by name as a stream
+        p = name;
+    }
+    Temp_file(Temp_file&& t) noexcept : p{exchange(t.p,{})} {}
+    ~Temp_file() { if (!p.empty()) { error_code ec; remove(p,ec); } }
+    const path& name() const { return p; }
+private:
+    path p;
+};
+
+Temp_file write_run(vector<string_view> words) // sort, deduplicate, and write one run
+{
+    ranges::sort(words);
+    auto [last,end] = ranges::unique(words);
+    words.erase(last,end);
+    Temp_file f;
+    ofstream os {f.name(),ios::binary};
+    for (auto w : words)
+        os << w << '\n';
+    os.close(); // flush now: a full disk must be noticed before the run is used
+    if (!os)
+        throw runtime_error{"can't write "+f.name().string()};
+    return f;
+}
+
+void merge_runs(const vector<Temp_file>& runs, ostream& os) // k-way merge, dropping duplicates
+{
+    vector<unique_ptr<Input_source>> in; // each run is mapped, so its lines stay valid
+    using Head = pair<string_view,size_t>; // current word of run i
+    priority_queue<Head,vector<Head>,greater<>> heads; // smallest word on top
+    for (size_t i = 0; i!=runs.size(); ++i) {
+        in.push_back(make_unique<Input_source>(runs[i].name()));
+        if (string_view w; in[i]->next_line(w))
+            heads.push({w,i});
+    }
+    string_view prev;
+    bool first = true;
+    while (!heads.empty()) {
+        auto [w,i] = heads.top();
+        heads.pop();
+        if (first || w!=prev) { // different runs may hold the same word
+            os << w << '\n';
+            prev = w;
+            first = false;
+        }
+        if (string_view next; in[i]->next_line(next))
+            heads.push({next,i});
+    }
+}
+
+void external_sort_unique(Input_source& in, ostream& os, size_t memory_budget, unsigned threads = thread::hardware_concurrency())
+{
+    constexpr size_t fan_in = 256; // runs merged at a time; each needs a mapping and its own read-ahead
+    threads = max(threads,1u);
+    const size_t run_bytes = max<size_t>(memory_budget/(threads+1),1<<20); // threads runs being sorted plus one being filled
+    vector<Temp_file> runs;
+    deque<future<Temp_file>> sorting;
+
+    auto start_run = [&](shared_ptr<string> chars, vector<pair<size_t,size_t>> pieces) {
+        if (sorting.size()==threads) { // don't use more memory than allowed: wait for the oldest run to be written
+            runs.push_back(sorting.front().get());
+            sorting.pop_front();
+        }
+        sorting.push_back(async(launch::async,[chars,pieces = move(pieces)] {
+            vector<string_view> words;
+            words.reserve(pieces.size());
+            for (auto [pos,len] : pieces)
+                words.emplace_back(chars->data()+pos,len);
+            return write_run(move(words));
+        }));
+    };
+
+    auto chars = make_shared<string>(); // the characters of the words of the current run
+    vector<pair<size_t,size_t>> pieces; // where each word is in chars (chars may be reallocated while filling)
+    for (string_view w; in.next_word(w); ) {
+        pieces.push_back({chars->size(),w.size()});
+        chars->append(w);
+        if (chars->size()+pieces.size()*sizeof(pieces[0])>=run_bytes) {
+            start_run(move(chars),move(pieces));
+            chars = make_shared<string>();
+            pieces = {};
+        }
+    }
+    if (!pieces.empty())
+        start_run(move(chars),move(pieces));
+    for (auto& f : sorting)
+        runs.push_back(f.get());
+
+    while (runs.size()>fan_in) { // too many runs to merge at once: merge groups of them into longer runs
+        vector<Temp_file> merged;
+        for (size_t i = 0; i<runs.size(); i += fan_in) {
+            vector<Temp_file> group;
+            for (size_t j = i; j!=min(i+fan_in,runs.size()); ++j)
+                group.push_back(move(runs[j]));
+            Temp_file f;
+            ofstream tmp {f.name(),ios::binary};
+            merge_runs(group,tmp);
+            tmp.close();
+            if (!tmp) // else a truncated run would silently lose words
+                throw runtime_error{"can't write "+f.name().string()};
+            merged.push_back(move(f));
+        } // group's files are removed here
+        runs = move(merged);
+    }
+    merge_runs(runs,os);
+}
+
+int main() {
+    string from, to;
+    cin >> from >> to; // get source and target file names
+    Input_source is {path{from}};
+    ofstream os {to};
+    external_sort_unique(is,os,1<<30); // use at most about 1GB for words
+    os.close(); // flush, so that a write error is reported
+    return !os;
+}
+
+// When the words do fit in memory, the set<string> version is the simplest, but it allocates a tree node and a string
+// per word and compares whole strings all the way down the tree. Using string_views into a mapped file
+// and sorting them 'radix-wise' is much faster, and the work splits naturally among threads:
+// • partition the words on their first character into 257 buckets ('ended here' and each of the 256 byte values)
+// • each bucket can be sorted independently: large buckets are partitioned again on the next character,
+//   small ones are finished with sort(); these pieces of work are shared out among the threads
+// • equal words end up in the same bucket, so duplicates are removed inside each bucket, also in parallel
+// • finally, the output is assembled into a single buffer and written with one write()
+class Radix_sorter {
+public:
+    explicit Radix_sorter(vector<string_view>& w, unsigned nthreads) : words{w}, tmp(w.size()), threads{max(nthreads,1u)} {}
+
+    // Sort the words, remove duplicates, and return the surviving [first:last) ranges of words in order:
+    vector<pair<size_t,size_t>> run()
+    {
+        push({0,words.size(),0});
+        vector<jthread> workers;
+        for (unsigned i = 0; i!=threads; ++i)
+            workers.emplace_back([this] { work(); });
+        workers.clear(); // join
+        ranges::sort(leaves);
+        return leaves;
+    }
+
+private:
+    struct Job {
+        size_t first;
+        size_t last;
+        size_t depth; // the characters before depth are the same for all words in [first:last)
+    };
+
+    static int key(string_view s, size_t depth) { return depth<s.size() ? static_cast<unsigned char>(s[depth])+1 : 0; }
+
+    void push(Job j)
+    {
+        {
+            scoped_lock lck {mtx};
+            jobs.push_back(j);
+        }
+        cv.notify_one();
+    }
+
+    void work()
+    {
+        while (true) {
+            Job j;
+            {
+                unique_lock lck {mtx};
+                cv.wait(lck,[this] { return !jobs.empty() || active==0; });
+                if (jobs.empty()) // and nobody is working, so no more jobs will come
+                    return;
+                j = jobs.back();
+                jobs.pop_back();
+                ++active;
+            }
+            process(j);
+            {
+                scoped_lock lck {mtx};
+                --active;
+            }
+            cv.notify_all();
+        }
+    }
+
+    void process(Job j)
+    {
+        constexpr size_t small = 1024; // below this, partitioning costs more than it saves
+        size_t n = j.last-j.first;
+        if (n<=small) {
+            auto b = words.begin()+j.first;
+            auto e = words.begin()+j.last;
+            sort(b,e,[d = j.depth](string_view x, string_view y) { return x.substr(min(d,x.size()))<y.substr(min(d,y.size())); });
+            leaf(j.first,unique(b,e)-words.begin());
+            return;
+        }
+        array<size_t,258> start {}; // counting sort on the character at depth
+        for (size_t i = j.first; i!=j.last; ++i)
+            ++start[key(words[i],j.depth)+1];
+        for (size_t k = 1; k!=start.size(); ++k)
+            start[k] += start[k-1];
+        array<size_t,258> next = start;
+        for (size_t i = j.first; i!=j.last; ++i)
+            tmp[j.first+next[key(words[i],j.depth)]++] = words[i];
+        copy(tmp.begin()+j.first,tmp.begin()+j.last,words.begin()+j.first);
+        if (start[1]>0) // the words that end at depth are all equal: keep one
+            leaf(j.first,j.first+1);
+        for (size_t k = 1; k!=257; ++k)
+            if (start[k+1]>start[k])
+                push({j.first+start[k],j.first+start[k+1],j.depth+1});
+    }
+
+    void leaf(size_t first, size_t last) // [first:last) is sorted, deduplicated, and final
+    {
+        scoped_lock lck {mtx};
+        leaves.push_back({first,last});
+    }
+
+    vector<string_view>& words;
+    vector<string_view> tmp;
+    unsigned threads;
+    mutex mtx;
+    condition_variable cv;
+    vector<Job> jobs;
+    int active = 0;
+    vector<pair<size_t,size_t>> leaves;
+};
+
+void sort_unique_write(vector<string_view>& words, int fd, unsigned threads = thread::hardware_concurrency())
+{
+    auto leaves = Radix_sorter{words,threads}.run();
+    vector<size_t> offset(leaves.size()+1); // where each leaf's text goes in the output
+    for (size_t i = 0; i!=leaves.size(); ++i) {
+        size_t bytes = 0;
+        for (size_t k = leaves[i].first; k!=leaves[i].second; ++k)
+            bytes += words[k].size()+1;
+        offset[i+1] = offset[i]+bytes;
+    }
+    string out(offset.back(),'\n');
+    {
+        atomic<size_t> next_leaf = 0;
+        vector<jthread> fill;
+        for (unsigned t = 0; t!=max(threads,1u); ++t)
+            fill.emplace_back([&] { // copy the words of each leaf into its own slice of out
+                for (size_t i; (i = next_leaf++)<leaves.size(); ) {
+                    char* p = out.data()+offset[i];
+                    for (size_t k = leaves[i].first; k!=leaves[i].second; ++k) {
+                        p = ranges::copy(words[k],p).out;
+                        *p++ = '\n';
+                    }
+                }
+            });
+    }
+    for (size_t done = 0; done<out.size(); ) { // one write() (unless the system insists on a partial write)
+        ssize_t n = ::write(fd,out.data()+done,out.size()-done);
+        if (n<0 && errno!=EINTR)
+            throw system_error{errno,system_category(),"write failed"};
+        done += max<ssize_t>(n,0);
+    }
+}
+
+int main() {
+    string from, to;
+    cin >> from >> to; // get source and target file names
+    Input_source is {path{from}};
+    Input_source text {is.all()};
+    vector<string_view> b;
+    ranges::copy(text.words(),back_inserter(b));
+    int fd = ::open(to.c_str(),O_WRONLY|O_CREAT|O_TRUNC,0644);
+    if (fd<0)
+        return 1;
+    sort_unique_write(b,fd);
+    return ::close(fd)!=0;
+}
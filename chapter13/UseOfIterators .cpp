@@ -59,3 +59,103 @@ void test() {
         *p = "vert";
 }
 
+
+// find_all() for a string looks at one character at a time and does a push_back() for each hit.
+// A processor can compare 16 (SSE2) or 32 (AVX2) characters in one instruction and summarize the results as a bitmask:
+// bit i is set if character i matched. We compare 64 characters at a time into a uint64_t,
+// and then turn the set bits into positions with countr_zero() (from <bit>), which skips non-matches for free.
+// Which instructions are available is determined once, at run time, as for the Aligned_vector kernels.
+namespace scan {
+    uint64_t mask64_scalar(const char* p, char c) // the portable version
+    {
+        uint64_t m = 0;
+        for (int i = 0; i!=64; ++i)
+            m |= uint64_t(p[i]==c)<<i;
+        return m;
+    }
+#if defined(__x86_64__) || defined(__i386__)
+    __attribute__((target("sse2"))) uint64_t mask64_sse2(const char* p, char c)
+    {
+        const __m128i cc = _mm_set1_epi8(c);
+        uint64_t m = 0;
+        for (int i = 0; i!=4; ++i) {
+            __m128i x = _mm_loadu_si128(reinterpret_cast<const __m128i*>(p+16*i));
+            m |= uint64_t(uint16_t(_mm_movemask_epi8(_mm_cmpeq_epi8(x,cc))))<<(16*i);
+        }
+        return m;
+    }
+    __attribute__((target("avx2"))) uint64_t mask64_avx2(const char* p, char c)
+    {
+        const __m256i cc = _mm256_set1_epi8(c);
+        __m256i lo = _mm256_loadu_si256(reinterpret_cast<const __m256i*>(p));
+        __m256i hi = _mm256_loadu_si256(reinterpret_cast<const __m256i*>(p+32));
+        uint32_t mlo = _mm256_movemask_epi8(_mm256_cmpeq_epi8(lo,cc));
+        uint32_t mhi = _mm256_movemask_epi8(_mm256_cmpeq_epi8(hi,cc));
+        return (uint64_t(mhi)<<32) | mlo;
+    }
+#endif
+    using Mask_fct = uint64_t(*)(const char*, char);
+    Mask_fct mask64()
+    {
+        static const Mask_fct f = [] {
+#if defined(__x86_64__) || defined(__i386__)
+            __builtin_cpu_init();
+            if (__builtin_cpu_supports("avx2"))
+                return mask64_avx2;
+            if (__builtin_cpu_supports("sse2"))
+                return mask64_sse2;
+#endif
+            return mask64_scalar;
+        }();
+        return f;
+    }
+
+    // Call f(i) for each position i with s[i]==c, in order:
+    template<typename F>
+    void for_each_match(string_view s, char c, F f)
+    {
+        Mask_fct block = mask64();
+        size_t n = s.size();
+        size_t i = 0;
+        for (; i+64<=n; i += 64)
+            for (uint64_t m = block(s.data()+i,c); m; m &= m-1) // m&(m-1) clears the lowest set bit
+                f(i+countr_zero(m));
+        for (; i!=n; ++i) // fewer than 64 characters left
+            if (s[i]==c)
+                f(i);
+    }
+
+    // The masks themselves: bit i%64 of word i/64 is set if s[i]==c. A compact result (one bit per character)
+    // that can be combined with other masks (e.g., (quotes & ~escaped)) before positions are needed:
+    vector<uint64_t> match_mask(string_view s, char c)
+    {
+        vector<uint64_t> res((s.size()+63)/64);
+        Mask_fct block = mask64();
+        size_t i = 0;
+        for (; i+64<=s.size(); i += 64)
+            res[i/64] = block(s.data()+i,c);
+        for (; i!=s.size(); ++i)
+            res[i/64] |= uint64_t(s[i]==c)<<(i%64);
+        return res;
+    }
+
+    size_t count(string_view s, char c) // no positions needed: just count the bits
+    {
+        Mask_fct block = mask64();
+        size_t n = 0;
+        size_t i = 0;
+        for (; i+64<=s.size(); i += 64)
+            n += popcount(block(s.data()+i,c));
+        for (; i!=s.size(); ++i)
+            n += s[i]==c;
+        return n;
+    }
+}
+
+vector<char*> find_all_fast(string& s, char c) // same result as find_all(s,c)
+{
+    vector<char*> res;
+    res.reserve(scan::count(s,c)); // a second pass, but a fast one, and then no reallocation
+    scan::for_each_match(s,c,[&](size_t i) { res.push_back(&s[i]); });
+    return res;
+}
@@ -127,6 +127,154 @@ void f(const vector<Record>& v) // assume that v is sorted on its "name" field
         cout << *p; // assume that << is defined for Record
 }
 
+// Each equal_range() on a large sorted vector is a binary search: about log2(n) probes, each at an unrelated
+// place in memory, so for millions of Records almost every probe is a cache miss (and often a second miss
+// to reach the characters of the name). For many lookups in a table that doesn't change, a different layout pays:
+// • the 'Eytzinger' layout stores the sorted keys in the order of a breadth-first walk of the binary search tree:
+//   the root at [1], the children of [k] at [2k] and [2k+1]. The first levels of the tree share a few cache lines,
+//   and the nodes two levels below [k] (that is, [4k]..[4k+3]) are adjacent, so they can be prefetched in one go
+// • each node holds the first 8 characters of its name as an integer, so most comparisons don't touch the string
+// • a batch of queries is searched in lock step, so that the cache misses of different queries overlap
+class Record_index {
+public:
+    explicit Record_index(vector<Record> v) : recs{move(v)}
+    {
+        ranges::stable_sort(recs,[](const Record& a, const Record& b) { return a.name<b.name; });
+        tree.resize(recs.size()+1); // tree[0] is unused
+        size_t next = 0;
+        build(1,next);
+    }
+
+    const vector<Record>& records() const { return recs; } // sorted by name
+
+    // [first:last) in records() of the Records named name:
+    pair<size_t,size_t> equal_range(string_view name) const
+    {
+        Key key {name};
+        return {search<false>(key),search<true>(key)};
+    }
+
+    // Many queries at a time; res[i] is equal_range(names[i]):
+    vector<pair<size_t,size_t>> equal_ranges(span<const string_view> names) const
+    {
+        vector<pair<size_t,size_t>> res(names.size());
+        constexpr size_t lanes = 16; // queries in flight at the same time
+        for (size_t b = 0; b<names.size(); b += lanes) {
+            size_t m = min(lanes,names.size()-b);
+            array<Key,lanes> keys;
+            for (size_t i = 0; i!=m; ++i)
+                keys[i] = Key{names[b+i]};
+            array<size_t,lanes> lo;
+            array<size_t,lanes> hi;
+            search_batch<false>(keys.data(),lo.data(),m);
+            search_batch<true>(keys.data(),hi.data(),m);
+            for (size_t i = 0; i!=m; ++i)
+                res[b+i] = {lo[i],hi[i]};
+        }
+        return res;
+    }
+
+private:
+    struct Key {
+        Key() = default;
+        explicit Key(string_view s) : name{s}, prefix{prefix_of(s)} {}
+        string_view name;
+        uint64_t prefix = 0;
+    };
+    struct alignas(16) Node {
+        uint64_t prefix; // the first 8 characters, big-endian, so integer order is string order
+        uint32_t rank; // index in recs
+    };
+
+    // The 4 Nodes at [4k] start at byte 64k of the tree, so they share a cache line only if the tree itself
+    // starts on a cache-line boundary; the default allocator promises just 16-byte alignment:
+    template<typename T>
+    struct Line_allocator {
+        using value_type = T;
+        Line_allocator() = default;
+        template<typename U>
+        Line_allocator(const Line_allocator<U>&) {}
+        T* allocate(size_t n) { return static_cast<T*>(::operator new(n*sizeof(T),align_val_t{64})); }
+        void deallocate(T* p, size_t) { ::operator delete(p,align_val_t{64}); }
+        bool operator==(const Line_allocator&) const = default;
+    };
+
+    static uint64_t prefix_of(string_view s)
+    {
+        uint64_t p = 0;
+        for (size_t i = 0; i!=8; ++i)
+            p = (p<<8) | (i<s.size() ? static_cast<unsigned char>(s[i]) : 0);
+        return p;
+    }
+
+    void build(size_t k, size_t& next) // in-order walk of the implicit tree assigns the sorted records
+    {
+        if (k>=tree.size())
+            return;
+        build(2*k,next);
+        tree[k] = {prefix_of(recs[next].name),static_cast<uint32_t>(next)};
+        ++next;
+        build(2*k+1,next);
+    }
+
+    template<bool upper> // lower bound: go right if node<key; upper bound: go right if node<=key
+    bool go_right(const Node& n, const Key& key) const
+    {
+        if (n.prefix!=key.prefix)
+            return n.prefix<key.prefix;
+        int c = string_view{recs[n.rank].name}.compare(key.name); // the prefixes are equal: look at the whole name
+        return upper ? c<=0 : c<0;
+    }
+
+    static size_t result(size_t k) // undo the final right turns: the answer is where we last went left
+    {
+        k >>= countr_one(k)+1;
+        return k;
+    }
+
+    template<bool upper>
+    size_t search(const Key& key) const
+    {
+        size_t n = recs.size();
+        size_t k = 1;
+        while (k<=n) {
+            __builtin_prefetch(tree.data()+4*k); // two levels down: 4 adjacent nodes, one cache line
+            k = 2*k+go_right<upper>(tree[k],key);
+        }
+        k = result(k);
+        return k==0 ? n : tree[k].rank;
+    }
+
+    template<bool upper>
+    void search_batch(const Key* keys, size_t* res, size_t m) const
+    {
+        size_t n = recs.size();
+        array<size_t,16> k;
+        k.fill(1);
+        for (int level = 0, depth = bit_width(n); level!=depth; ++level) // all searches take a step per level
+            for (size_t i = 0; i!=m; ++i)
+                if (k[i]<=n) {
+                    __builtin_prefetch(tree.data()+4*k[i]);
+                    k[i] = 2*k[i]+go_right<upper>(tree[k[i]],keys[i]);
+                }
+        for (size_t i = 0; i!=m; ++i) {
+            size_t r = result(k[i]);
+            res[i] = r==0 ? n : tree[r].rank;
+        }
+    }
+
+    vector<Record> recs;
+    vector<Node,Line_allocator<Node>> tree;
+};
+
+void f(const Record_index& index, const vector<string_view>& names)
+{
+    auto ranges = index.equal_ranges(names); // one call for many names
+    for (size_t i = 0; i!=names.size(); ++i)
+        for (auto p = ranges[i].first; p!=ranges[i].second; ++p) // print all records with names[i]
+            cout << index.records()[p];
+}
+
 // A pair provides operators, such as =, ==, and <, if its elements do. Type deduction makes it easy to
 // create a pair without explicitly mentioning its type.
 void f(vector<string>& v)
@@ -10,3 +10,17 @@ void log(const string& mess = "", const source_location loc = source_location::c
     << mess;
 }
 
+
+// This log() formats the message while its caller waits, and the output of two threads calling it at the same
+// time may be interleaved. A Log_sink (§11.7.5) takes a copy of the source_location (a small object referring to
+// data generated by the compiler) and of the raw values, and leaves the formatting to its consumer thread:
+void log(Log_sink& sink, string_view mess = "", const source_location loc = source_location::current())
+{
+    sink.log({mess,loc});
+}
+
+void work(Log_sink& sink, int item, double value)
+{
+    log(sink,"starting"); // the location of this call
+    sink.log("item ",item," has value ",value); // also the location of this call
+}
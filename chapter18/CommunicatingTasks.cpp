@@ -59,6 +59,148 @@ double comp4(vector<double>& v)
     return f0.get()+f1.get()+f2.get()+f3.get(); // collect and combine the results
 }
 
+// comp4() is fine as an illustration, but for repeated use it has three weaknesses:
+// • the cutoff (10'000) and the number of tasks (4) are guesses that don't depend on the machine
+// • async() may create a new thread for each task, and creating a thread costs far more than adding a few thousand doubles
+// • adding a long sequence of doubles one by one accumulates rounding errors
+// We can address the first two by keeping a set of threads ready to run tasks (a 'thread pool'),
+// and by computing the number of chunks from the number of cores and the size of the cache:
+class Thread_pool {
+public:
+    explicit Thread_pool(unsigned n = max(1u,thread::hardware_concurrency()))
+    {
+        for (unsigned i = 0; i!=n; ++i)
+            workers.emplace_back([this](stop_token tok) { run(tok); });
+    }
+    ~Thread_pool()
+    {
+        for (auto& t : workers)
+            t.request_stop();
+        cv.notify_all();
+    } // the jthreads join here
+
+    template<typename F>
+    auto submit(F f) -> future<invoke_result_t<F>> // run f() on some worker; get its result from the future
+    {
+        auto task = make_shared<packaged_task<invoke_result_t<F>()>>(move(f)); // function<> needs a copyable callable
+        auto res = task->get_future();
+        {
+            scoped_lock lck {mtx};
+            tasks.push([task] { (*task)(); });
+        }
+        cv.notify_one();
+        return res;
+    }
+
+    unsigned size() const { return workers.size(); }
+
+private:
+    void run(stop_token tok)
+    {
+        while (true) {
+            function<void()> task;
+            {
+                unique_lock lck {mtx};
+                if (!cv.wait(lck,tok,[this] { return !tasks.empty(); })) // false: stop was requested
+                    return;
+                task = move(tasks.front());
+                tasks.pop();
+            }
+            task(); // run the task without holding the lock
+        }
+    }
+
+    mutex mtx;
+    condition_variable_any cv; // condition_variable_any can wait on a stop_token
+    queue<function<void()>> tasks;
+    vector<jthread> workers; // last: the threads must be stopped before the rest is destroyed
+};
+
+Thread_pool& default_pool() // created on first use, shared by all callers
+{
+    static Thread_pool pool;
+    return pool;
+}
+
+// How a reduction was split up; returned so that the choice can be logged and tuned:
+struct Split {
+    size_t chunk_size = 0; // elements per chunk
+    size_t chunks = 0; // number of chunks (1 means "done sequentially")
+    unsigned threads = 0; // threads available
+};
+
+Split choose_split(size_t n, size_t elem_size, unsigned threads)
+{
+    constexpr size_t min_chunk_bytes = 64*1024; // below this, handing a chunk to another thread costs more than it gains
+    constexpr size_t cache_bytes = 256*1024; // roughly a per-core (L2) cache; chunks much larger than that gain nothing
+    size_t total = n*elem_size;
+    size_t per_thread = total/(threads*4); // a few chunks per thread, so that a slow thread doesn't hold up the rest
+    size_t chunk_bytes = clamp(per_thread,min_chunk_bytes,cache_bytes);
+    Split s;
+    s.threads = threads;
+    if (threads<=1 || total<2*min_chunk_bytes) { // no help available, or not worth it
+        s.chunk_size = n;
+        s.chunks = 1;
+        return s;
+    }
+    s.chunk_size = max<size_t>(1,chunk_bytes/elem_size);
+    s.chunks = max<size_t>(1,(n+s.chunk_size-1)/s.chunk_size);
+    return s;
+}
+
+// The third problem is addressed by offering better ways of adding up a chunk.
+// Kahan summation keeps track of the low-order bits lost in each addition:
+double kahan_accum(const double* beg, const double* end, double init)
+{
+    double sum = init;
+    double c = 0; // running compensation for lost low-order bits
+    for (; beg!=end; ++beg) {
+        double y = *beg-c;
+        double t = sum+y;
+        c = (t-sum)-y; // (t-sum) recovers the high-order part of y; subtracting y recovers the lost part
+        sum = t;
+    }
+    return sum;
+}
+// Pairwise summation adds the two halves separately, so that errors grow with log(n) rather than n:
+double pairwise_accum(const double* beg, const double* end, double init)
+{
+    if (end-beg<=128) // small enough: add sequentially
+        return accumulate(beg,end,init);
+    const double* mid = beg+(end-beg)/2;
+    return pairwise_accum(beg,mid,init)+pairwise_accum(mid,end,0.0);
+}
+
+// parallel_reduce() applies an accum()-like operation to each chunk and then combines the chunk results in order,
+// so the result doesn't depend on which thread finished first:
+template<typename T, typename Op = T(*)(const T*, const T*, T), typename Pool = Thread_pool>
+T parallel_reduce(const T* first, const T* last, T init, Op op, Pool& pool = default_pool(), Split* report = nullptr)
+{
+    Split s = choose_split(last-first,sizeof(T),pool.size());
+    if (report)
+        *report = s;
+    if (s.chunks==1) // is it worth using concurrency?
+        return op(first,last,init);
+    vector<future<T>> parts;
+    parts.reserve(s.chunks);
+    for (const T* p = first; p<last; p += min<size_t>(s.chunk_size,last-p)) {
+        const T* q = p+min<size_t>(s.chunk_size,last-p);
+        parts.push_back(pool.submit([=] { return op(p,q,T{}); }));
+    }
+    vector<T> sums;
+    for (auto& f : parts)
+        sums.push_back(f.get());
+    return op(sums.data(),sums.data()+sums.size(),init); // combine the partial results the same way
+}
+
+double comp(vector<double>& v)
+{
+    Split s;
+    double res = parallel_reduce(v.data(),v.data()+v.size(),0.0,kahan_accum,default_pool(),&s);
+    clog << "comp(): " << s.chunks << " chunks of " << s.chunk_size << " on " << s.threads << " threads\n";
+    return res;
+}
+
 //Stopping a thread
 atomic<int> result = -1; // put a resulting index here
 template<class T> struct Range { T* first; T last; }; // a way of passing a range of Ts
@@ -88,3 +230,68 @@ void find_all(vector<string>& vs, const string& key)
 }
 // The stop_sources produces the stop_tokens through which requests to stop are communicated to threads.
 
+
+// find_all() has three problems: it uses exactly two threads, the caller polls result every 10ms
+// (so no answer can arrive in less than 10ms), and which match is reported depends on which thread happens to win.
+// parallel_find() splits the search into chunks run by a thread pool, returns the lowest matching index,
+// and waits for completion on a latch rather than by sleeping:
+// • when a match is found at index i, every chunk stops as soon as it has passed i (nothing beyond i can matter),
+//   but a chunk before i keeps going, because it could find a lower index
+// • a stop requested on the caller's stop_token is forwarded to the stop_source shared by all chunks,
+//   so the whole search can be cancelled from outside
+template<typename T, typename Pred, typename Pool = Thread_pool>
+optional<size_t> parallel_find(const vector<T>& v, Pred pred, stop_token cancel = {}, Pool& pool = default_pool())
+{
+    constexpr size_t none = numeric_limits<size_t>::max();
+    constexpr size_t min_chunk = 4096; // elements; smaller chunks aren't worth handing to another thread
+    size_t n = v.size();
+    size_t chunks = clamp<size_t>(n/min_chunk,1,pool.size()*4);
+    size_t chunk_size = (n+chunks-1)/max<size_t>(chunks,1);
+
+    atomic<size_t> best = none; // lowest matching index found so far
+    stop_source ss; // shared by all chunks
+    stop_callback forward {cancel,[&] { ss.request_stop(); }};
+    latch done {static_cast<ptrdiff_t>(chunks)};
+    mutex error_mutex;
+    exception_ptr error; // the first exception thrown by pred
+
+    for (size_t c = 0; c!=chunks; ++c) {
+        pool.submit([&,c] {
+            stop_token tok = ss.get_token();
+            size_t last = min(n,(c+1)*chunk_size);
+            try {
+                for (size_t i = c*chunk_size; i<last && i<best.load(memory_order_relaxed) && !tok.stop_requested(); ++i)
+                    if (pred(v[i])) {
+                        size_t b = best.load();
+                        while (i<b && !best.compare_exchange_weak(b,i)) // keep the minimum
+                            ;
+                        break;
+                    }
+            }
+            catch (...) { // keep the first exception, and stop the other chunks
+                {
+                    scoped_lock lck {error_mutex};
+                    if (!error)
+                        error = current_exception();
+                }
+                ss.request_stop();
+            }
+            done.count_down(); // every chunk must count down, or done.wait() would never return
+        });
+    }
+    done.wait(); // blocks without polling; the chunks refer to local variables, so we must wait for all
+    if (error)
+        rethrow_exception(error); // as if pred had thrown in the caller
+    if (cancel.stop_requested())
+        return {}; // cancelled: the answer may be incomplete
+    if (best==none)
+        return {};
+    return best.load();
+}
+
+void find_all2(vector<string>& vs, const string& key, stop_token cancel)
+{
+    if (auto r = parallel_find(vs,[&](const string& s) { return match(s,key); },cancel)) {
+        // ... use *r, the index of the first matching string ...
+    }
+}
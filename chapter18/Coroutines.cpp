@@ -76,4 +76,380 @@ task char_seq(char start)
     }
 }
 // The ‘magic’ is in the return type task; it holds the state of the coroutine (in effect the function’s
-// stack frame) between calls and determines the meaning of the co_yield
\ No newline at end of file
+// stack frame) between calls and determines the meaning of the co_yield
+// test() above is a toy: the order is fixed in advance, the Events are leaked if an exception is thrown,
+// and each resumption goes through a virtual call. A real scheduler keeps a queue of coroutines that are
+// ready to run and lets the coroutines themselves decide when to give up the processor (co_yield) or
+// to sleep (co_await sched.sleep_for(d)). The queue holds coroutine_handles directly: resuming one is an
+// indirect jump into the coroutine, with no Event_base and no virtual function.
+class Scheduler;
+
+class task {
+public:
+    struct promise_type;
+    using handle = coroutine_handle<promise_type>;
+
+    struct Yield { // co_yield: go to the back of the ready queue
+        bool await_ready() noexcept { return false; }
+        void await_suspend(handle h);
+        void await_resume() noexcept {}
+    };
+    struct Final { // at the end, the coroutine destroys its own state and tells the scheduler
+        bool await_ready() noexcept { return false; }
+        void await_suspend(handle h) noexcept;
+        void await_resume() noexcept {}
+    };
+
+    struct promise_type {
+        Scheduler* sched = nullptr;
+        int priority = 0; // higher runs first
+        chrono::steady_clock::time_point deadline = chrono::steady_clock::time_point::max(); // among equals, earliest first
+        task get_return_object() { return task{handle::from_promise(*this)}; }
+        suspend_always initial_suspend() noexcept { return {}; } // don't run until scheduled
+        Final final_suspend() noexcept { return {}; }
+        Yield yield_value(int) { return {}; }
+        void return_void() {}
+        void unhandled_exception() { terminate(); }
+    };
+
+    task(task&& t) noexcept : h{exchange(t.h,{})} {}
+    ~task() { if (h) h.destroy(); } // a task that was never given to a Scheduler doesn't leak
+    handle release() { return exchange(h,{}); }
+private:
+    explicit task(handle hh) : h{hh} {}
+    handle h;
+};
+
+class Scheduler {
+public:
+    using clock = chrono::steady_clock;
+
+    Scheduler() = default;
+    Scheduler(const Scheduler&) = delete;
+    Scheduler& operator=(const Scheduler&) = delete;
+    ~Scheduler() // destroy coroutines that never finished
+    {
+        for (; !ready.empty(); ready.pop())
+            ready.top().h.destroy();
+        for (; !timers.empty(); timers.pop())
+            timers.top().h.destroy();
+    }
+
+    void spawn(task t, int priority = 0, clock::time_point deadline = clock::time_point::max())
+    {
+        auto h = t.release();
+        h.promise().sched = this;
+        h.promise().priority = priority;
+        h.promise().deadline = deadline;
+        {
+            scoped_lock lck {mtx};
+            ++live;
+        }
+        make_ready(h);
+    }
+
+    struct Sleep {
+        Scheduler* s;
+        clock::time_point when;
+        bool await_ready() const { return clock::now()>=when; }
+        void await_suspend(task::handle h) { s->add_timer(when,h); }
+        void await_resume() const {}
+    };
+    Sleep sleep_for(clock::duration d) { return {this,clock::now()+d}; }
+    Sleep sleep_until(clock::time_point t) { return {this,t}; }
+
+    // Run on this thread until every task has finished or max_steps resumptions have been done:
+    size_t run(size_t max_steps = numeric_limits<size_t>::max()) { return work(max_steps); }
+
+    // M:N: run the tasks on n threads until every task has finished
+    void run_parallel(unsigned n = thread::hardware_concurrency())
+    {
+        vector<jthread> threads;
+        for (unsigned i = 0; i!=n; ++i)
+            threads.emplace_back([this] { work(numeric_limits<size_t>::max()); });
+    }
+
+    void make_ready(task::handle h)
+    {
+        {
+            scoped_lock lck {mtx};
+            ready.push({h.promise().priority,h.promise().deadline,seq++,h});
+        }
+        cv.notify_one();
+    }
+
+    void add_timer(clock::time_point when, task::handle h)
+    {
+        {
+            scoped_lock lck {mtx};
+            timers.push({when,seq++,h});
+        }
+        cv.notify_one(); // a worker may need to wait for an earlier time
+    }
+
+    void finished()
+    {
+        scoped_lock lck {mtx};
+        --live;
+    }
+
+private:
+    struct Ready {
+        int priority;
+        clock::time_point deadline;
+        size_t seq; // first come, first served among equals
+        task::handle h;
+        bool operator<(const Ready& x) const // "runs after x"
+        {
+            if (priority!=x.priority)
+                return priority<x.priority;
+            if (deadline!=x.deadline)
+                return deadline>x.deadline;
+            return seq>x.seq;
+        }
+    };
+    struct Timer {
+        clock::time_point when;
+        size_t seq;
+        task::handle h;
+        bool operator<(const Timer& x) const { return tie(when,seq)>tie(x.when,x.seq); } // "fires after x"
+    };
+
+    size_t work(size_t max_steps)
+    {
+        size_t steps = 0;
+        unique_lock lck {mtx};
+        while (steps<max_steps) {
+            for (auto now = clock::now(); !timers.empty() && timers.top().when<=now; timers.pop()) // wake sleepers
+                ready.push({timers.top().h.promise().priority,timers.top().h.promise().deadline,seq++,timers.top().h});
+            if (!ready.empty()) {
+                auto h = ready.top().h;
+                ready.pop();
+                ++running;
+                lck.unlock();
+                h.resume(); // runs until the next co_yield, co_await, or the end
+                ++steps;
+                lck.lock();
+                if (--running==0 && ready.empty() && timers.empty())
+                    cv.notify_all(); // let the other workers see that we are done
+                continue;
+            }
+            if (live==0 || (timers.empty() && running==0)) // nothing left that could ever become ready
+                break;
+            if (timers.empty())
+                cv.wait(lck);
+            else
+                cv.wait_until(lck,timers.top().when);
+        }
+        return steps;
+    }
+
+    mutex mtx;
+    condition_variable cv;
+    priority_queue<Ready> ready;
+    priority_queue<Timer> timers;
+    size_t seq = 0;
+    int live = 0; // spawned and not yet finished
+    int running = 0; // being resumed right now
+};
+
+void task::Yield::await_suspend(handle h) { h.promise().sched->make_ready(h); }
+
+void task::Final::await_suspend(handle h) noexcept
+{
+    Scheduler* s = h.promise().sched;
+    h.destroy();
+    if (s)
+        s->finished();
+}
+
+// sequencer() and char_seq() need no change. Now, the order is decided by the scheduler.
+// Priorities are strict: a ready coroutine of lower priority never runs while one of higher priority is ready,
+// so a higher-priority coroutine that never finishes (or sleeps) starves the others. Here, it does a bit of work and ends:
+task burst(int start, int n)
+{
+    for (int i = 0; i!=n; ++i) {
+        cout << "value: " << start+i << '\n';
+        co_yield 0; // requeued ahead of the lower-priority coroutines
+    }
+}
+
+void test2()
+{
+    Scheduler sched;
+    sched.spawn(sequencer(10)); // equal priorities: the two take turns once burst() has finished
+    sched.spawn(char_seq('a'));
+    sched.spawn(burst(100,3),1); // higher priority: runs first: 100 101 102
+    sched.run(9); // nine resumptions: 100 101 102, burst() ends, 10 a 11 b 12; the unfinished coroutines are destroyed with sched
+}
+
+// Coroutines can sleep without blocking a thread, so hundreds of thousands of them can share a few threads:
+task ticker(Scheduler& s, int id, int n)
+{
+    for (int i = 0; i!=n; ++i) {
+        co_await s.sleep_for(chrono::milliseconds{10});
+        // ... do a little work for id ...
+    }
+}
+
+void test3()
+{
+    Scheduler sched;
+    for (int i = 0; i!=100'000; ++i)
+        sched.spawn(ticker(sched,i,5));
+    sched.run_parallel(4); // M:N: 100'000 coroutines on 4 threads
+}
+
+// The generator<long long> used by fib() isn't defined above, and user() calls fib() for each number,
+// creating a new coroutine each time (so it prints 1 1 1 ...). A generator should be created once and iterated over.
+// Also, fib()'s a<b test fails after the first number (a==b==1); fib2() below tests for overflow instead.
+// Here is a generator<T> that is a range, so that it can be used in a range-for and composed with views (§14.3).
+// Yielded values are not copied: the generator refers to the object named in co_yield, which stays alive
+// while the coroutine is suspended.
+// The coroutine's state (its 'frame') is allocated by the promise_type's operator new(), so we can take frames
+// from a pool of recycled blocks rather than from the free store:
+class Frame_pool {
+public:
+    static void* allocate(size_t n)
+    {
+        size_t c = size_class(n);
+        if (c>=classes) // large frames are rare: use the free store
+            return ::operator new(n);
+        auto& fl = free_lists()[c];
+        if (fl.empty())
+            return ::operator new((c+1)*granule);
+        void* p = fl.back();
+        fl.pop_back();
+        return p;
+    }
+    static void deallocate(void* p, size_t n)
+    {
+        size_t c = size_class(n);
+        if (c>=classes) {
+            ::operator delete(p);
+            return;
+        }
+        free_lists()[c].push_back(p); // keep the block for the next frame of this size
+    }
+
+private:
+    static constexpr size_t granule = 64;
+    static constexpr size_t classes = 16; // frames up to 16*64 bytes are recycled
+    static size_t size_class(size_t n) { return (n+granule-1)/granule-1; }
+
+    struct Lists {
+        array<vector<void*>,classes> lists;
+        vector<void*>& operator[](size_t i) { return lists[i]; }
+        ~Lists()
+        {
+            for (auto& fl : lists)
+                for (void* p : fl)
+                    ::operator delete(p);
+        }
+    };
+    static Lists& free_lists() // one set per thread: no locking
+    {
+        thread_local Lists fl;
+        return fl;
+    }
+};
+
+template<typename T>
+class generator : public ranges::view_interface<generator<T>> {
+public:
+    struct promise_type {
+        const T* current = nullptr; // the value most recently yielded
+        exception_ptr error;
+
+        generator get_return_object() { return generator{handle::from_promise(*this)}; }
+        suspend_always initial_suspend() noexcept { return {}; } // start when the first value is asked for
+        suspend_always final_suspend() noexcept { return {}; }
+        suspend_always yield_value(const T& x) noexcept // x outlives the suspension, so no copy is needed
+        {
+            current = addressof(x);
+            return {};
+        }
+        void return_void() {}
+        void unhandled_exception() { error = current_exception(); }
+
+        static void* operator new(size_t n) { return Frame_pool::allocate(n); }
+        static void operator delete(void* p, size_t n) { Frame_pool::deallocate(p,n); }
+    };
+    using handle = coroutine_handle<promise_type>;
+
+    class iterator {
+    public:
+        using value_type = T;
+        using difference_type = ptrdiff_t;
+        iterator() = default;
+        explicit iterator(handle hh) : h{hh} {}
+        const T& operator*() const { return *h.promise().current; }
+        iterator& operator++()
+        {
+            h.resume(); // run to the next co_yield or to the end
+            if (h.done() && h.promise().error)
+                rethrow_exception(h.promise().error);
+            return *this;
+        }
+        void operator++(int) { ++*this; }
+        bool operator==(default_sentinel_t) const { return !h || h.done(); }
+    private:
+        handle h;
+    };
+
+    generator() = default;
+    generator(generator&& g) noexcept : h{exchange(g.h,{})} {}
+    generator& operator=(generator&& g) noexcept
+    {
+        if (this!=&g) {
+            if (h)
+                h.destroy();
+            h = exchange(g.h,{});
+        }
+        return *this;
+    }
+    ~generator() { if (h) h.destroy(); }
+
+    iterator begin() // an input range: begin() may be called only once
+    {
+        iterator p {h};
+        if (h)
+            ++p; // produce the first value
+        return p;
+    }
+    default_sentinel_t end() const { return {}; }
+
+private:
+    explicit generator(handle hh) : h{hh} {}
+    handle h;
+};
+
+static_assert(ranges::input_range<generator<int>>);
+static_assert(ranges::view<generator<int>>);
+
+generator<long long> fib2() // generate Fibonacci numbers; the generator ends when the coroutine does
+{
+    long long a = 0;
+    long long b = 1;
+    while (a<=numeric_limits<long long>::max()-b) { // stop before overflowing
+        auto next = a+b;
+        co_yield next;
+        a = b;
+        b = next;
+    }
+}
+
+void user2(int max)
+{
+    for (auto x : fib2() | views::take(max)) // one coroutine, composed with a view
+        cout << x << ' ';
+}
+// This generates
+// 1 2 3 5 8 13 ...
+
+// Yielding a reference means that large objects are not copied:
+generator<string> lines(istream& is)
+{
+    for (string line; getline(is,line); )
+        co_yield line; // the caller sees line itself
+}
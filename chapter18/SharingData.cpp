@@ -42,4 +42,208 @@ void f() {
         }
     }
     // ... use x ...
-}
\ No newline at end of file
+}
+// A shared_mutex keeps count of its readers in a single place, so every shared_lock writes to the same cache line.
+// With many cores and almost only readers, that cache line moving from core to core costs more than the reading.
+// A 'sharded' reader-writer lock gives each thread (well, each group of threads) its own reader count on its own cache line.
+// Readers then only touch their own shard; a writer pays instead, by checking every shard:
+class Sharded_shared_mutex {
+public:
+    void lock_shared()
+    {
+        auto& s = shards[my_shard()];
+        while (true) {
+            s.readers.fetch_add(1); // announce ourselves, then check for a writer
+            if (!writer.load())
+                return;
+            s.readers.fetch_sub(1); // a writer is active or waiting: back off until it is done
+            writer.wait(true);
+        }
+    }
+    void unlock_shared() { shards[my_shard()].readers.fetch_sub(1); }
+
+    void lock()
+    {
+        writers.lock(); // one writer at a time
+        writer.store(true); // new readers now back off ...
+        for (auto& s : shards) // ... and we wait for the current ones to leave
+            while (s.readers.load()!=0)
+                this_thread::yield();
+    }
+    void unlock()
+    {
+        writer.store(false);
+        writer.notify_all(); // wake the readers that backed off
+        writers.unlock();
+    }
+
+private:
+    static constexpr size_t nshards = 64;
+    struct alignas(64) Shard { // one cache line per shard
+        atomic<int> readers = 0;
+    };
+    static size_t my_shard() // fixed for a thread, so unlock_shared() finds the shard that lock_shared() used
+    {
+        static atomic<size_t> next = 0;
+        thread_local size_t s = next++%nshards;
+        return s;
+    }
+
+    array<Shard,nshards> shards;
+    alignas(64) atomic<bool> writer = false;
+    mutex writers;
+};
+// The seq_cst operations on readers and writer ensure that a reader and a writer can't both see the other as absent.
+
+// It is used exactly like shared_mutex:
+Sharded_shared_mutex smx;
+void reader2()
+{
+    shared_lock lck {smx}; // touches only this thread's shard
+    // ... read ...
+}
+void writer2()
+{
+    unique_lock lck {smx}; // waits for the readers in every shard
+    // ... write ...
+}
+
+// For a small value that can be copied as bits (e.g., a struct of a few numbers), readers need not write anything at all.
+// A 'sequence lock' keeps a version count that is odd while a write is in progress. A reader copies the value
+// and then checks that the version didn't change while it was copying; if it did, it simply tries again:
+template<typename T>
+    requires is_trivially_copyable_v<T>
+class Seqlock {
+public:
+    explicit Seqlock(const T& x = {}) { store(x); }
+
+    T load() const
+    {
+        array<uint64_t,nwords> buf;
+        while (true) {
+            uint64_t s1 = seq.load(memory_order_acquire);
+            if (s1&1) { // a writer is busy
+                this_thread::yield();
+                continue;
+            }
+            for (size_t i = 0; i!=nwords; ++i)
+                buf[i] = words[i].load(memory_order_relaxed);
+            atomic_thread_fence(memory_order_acquire);
+            if (seq.load(memory_order_relaxed)==s1) // nothing changed while we copied
+                break;
+        }
+        T res;
+        memcpy(&res,buf.data(),sizeof(T));
+        return res;
+    }
+
+    void store(const T& x)
+    {
+        array<uint64_t,nwords> buf {};
+        memcpy(buf.data(),&x,sizeof(T));
+        scoped_lock lck {writers}; // writers still exclude each other
+        uint64_t s = seq.load(memory_order_relaxed);
+        seq.store(s+1,memory_order_relaxed); // odd: write in progress
+        atomic_thread_fence(memory_order_release);
+        for (size_t i = 0; i!=nwords; ++i)
+            words[i].store(buf[i],memory_order_relaxed);
+        seq.store(s+2,memory_order_release); // even again: done
+    }
+
+private:
+    static constexpr size_t nwords = (sizeof(T)+7)/8;
+    atomic<uint64_t> seq = 0;
+    array<atomic<uint64_t>,nwords> words {}; // atomic words, so a torn read is a retry, not a data race
+    mutex writers;
+};
+
+struct Rates { double buy; double sell; int version; };
+Seqlock<Rates> rates;
+double spread()
+{
+    Rates r = rates.load(); // no write to shared memory: scales with the number of readers
+    return r.sell-r.buy;
+}
+
+// Note that f() above is subtly wrong: mut, init_x, and x are local, so each call gets its own,
+// and nothing is shared. Making them static (or global) fixes that, but the pattern is easy to get wrong
+// and has to be repeated for each lazily initialized object. Better to write it once:
+// a Lazy<T> holds a T that is constructed by the first call of get(), however many threads call get() at the same time.
+// After initialization, get() is a single acquire load and a test. Threads that arrive while another
+// thread is initializing sleep on the atomic (using a futex or similar where available) rather than spin:
+template<typename T, typename Init = function<T()>>
+class Lazy {
+public:
+    explicit Lazy(Init f) : init{move(f)} {}
+    Lazy(const Lazy&) = delete;
+    Lazy& operator=(const Lazy&) = delete;
+    ~Lazy()
+    {
+        if (state.load(memory_order_acquire)==ready)
+            destroy_at(ptr());
+    }
+
+    const T& get()
+    {
+        if (state.load(memory_order_acquire)==ready) // the fast path: no lock, no write
+            return *ptr();
+        return get_slow();
+    }
+    const T& operator*() { return get(); }
+    const T* operator->() { return &get(); }
+
+private:
+    enum : int { empty, busy, ready };
+
+    const T& get_slow()
+    {
+        int s = empty;
+        while (true) {
+            if (s==empty && state.compare_exchange_strong(s,busy,memory_order_acquire)) { // we initialize
+                try {
+                    construct_at(ptr(),init());
+                }
+                catch (...) { // let another thread try again
+                    state.store(empty,memory_order_release);
+                    state.notify_all();
+                    throw;
+                }
+                state.store(ready,memory_order_release);
+                state.notify_all(); // wake the threads waiting for us
+                return *ptr();
+            }
+            if (s==ready)
+                return *ptr();
+            if (s==busy)
+                state.wait(busy,memory_order_acquire); // sleep until state changes from busy
+            s = state.load(memory_order_acquire);
+        }
+    }
+
+    T* ptr() { return reinterpret_cast<T*>(buf); }
+
+    atomic<int> state = empty;
+    alignas(T) unsigned char buf[sizeof(T)]; // the T, once constructed
+    Init init;
+};
+
+template<typename F>
+Lazy(F) -> Lazy<invoke_result_t<F>,F>;
+
+// For example:
+Lazy<vector<double>> table {[] {
+    vector<double> t(1'000'000);
+    // ... compute the table ...
+    return t;
+}};
+double lookup(int i) { return table.get()[i]; } // the first caller computes the table; the rest wait or just use it
+
+// Even the acquire load can be avoided on the hot path by caching a pointer in each thread.
+// The compiler's thread_local initialization check involves no atomic operation:
+template<auto& lazy>
+const auto& cached_get()
+{
+    thread_local const auto* p = &lazy.get(); // initialized once per thread
+    return *p;
+}
+double fast_lookup(int i) { return cached_get<table>()[i]; }
@@ -59,4 +59,137 @@ void user(vector<double>& vec1, vector<double> vec2, vector<double> vec3)
     t3.join();
     cout << res1 << ' ' << res2 << ' ' << res3 << '\n';
 }
-// Here, cref(vec1) passes a const reference to vec1 as an argument to t1.
\ No newline at end of file
+// Here, cref(vec1) passes a const reference to vec1 as an argument to t1.
+// Creating a thread costs something like tens of microseconds, so a thread per small task wastes most of the time
+// on thread creation. Instead, we can create a set of threads once and hand tasks to them (a 'thread pool').
+// The Thread_pool in §18.5 uses a single queue; with many threads, that queue and its mutex become the bottleneck.
+// In a 'work-stealing' pool, each worker has its own deque of tasks:
+// • a worker pushes the tasks it spawns at the back of its own deque and takes work from the back (most recent first: good for the cache)
+// • a worker with nothing to do 'steals' from the front of another worker's deque (the oldest, typically largest, tasks)
+// • a task can spawn tasks and wait for them; while waiting, its thread runs other tasks rather than blocking
+// Here, each deque is protected by its own mutex. Lock-free deques are faster still, but much harder to get right.
+class Work_stealing_pool {
+public:
+    explicit Work_stealing_pool(unsigned n = max(1u,thread::hardware_concurrency()))
+    {
+        for (unsigned i = 0; i!=n; ++i)
+            queues.push_back(make_unique<Task_queue>());
+        for (unsigned i = 0; i!=n; ++i)
+            workers.emplace_back([this,i](stop_token tok) { run(tok,i); });
+    }
+    ~Work_stealing_pool()
+    {
+        for (auto& t : workers)
+            t.request_stop(); // workers finish the tasks already submitted, then exit
+        { scoped_lock lck {sleep_mtx}; }
+        cv.notify_all();
+    } // the jthreads join here
+
+    template<typename F>
+    auto submit(F f) -> future<invoke_result_t<F>> // run f() on some worker; get its result from the future
+    {
+        auto task = make_shared<packaged_task<invoke_result_t<F>()>>(move(f));
+        auto res = task->get_future();
+        size_t i = (current_pool==this) ? current_index : next_queue++%queues.size(); // spawned by a worker: keep it local
+        ++pending; // before the push: a worker could otherwise run the task and decrement pending first
+        try {
+            scoped_lock lck {queues[i]->mtx};
+            queues[i]->tasks.push_back([task] { (*task)(); });
+        }
+        catch (...) {
+            --pending;
+            throw;
+        }
+        { scoped_lock lck {sleep_mtx}; } // a worker is either before its check of pending or waiting: no lost wakeup
+        cv.notify_one();
+        return res;
+    }
+
+    template<typename T>
+    T wait(future<T>& f) // like f.get(), but keep running tasks while waiting, so nested tasks can't deadlock the pool
+    {
+        size_t self = (current_pool==this) ? current_index : 0;
+        while (f.wait_for(0s)!=future_status::ready)
+            if (!run_one(self))
+                this_thread::yield();
+        return f.get();
+    }
+
+    unsigned size() const { return workers.size(); }
+
+private:
+    struct Task_queue {
+        mutex mtx;
+        deque<function<void()>> tasks;
+    };
+
+    bool run_one(size_t self) // run one task: our own newest, or else the oldest from another worker
+    {
+        function<void()> task;
+        {
+            scoped_lock lck {queues[self]->mtx};
+            if (!queues[self]->tasks.empty()) {
+                task = move(queues[self]->tasks.back());
+                queues[self]->tasks.pop_back();
+            }
+        }
+        for (size_t k = 1; !task && k!=queues.size(); ++k) { // steal
+            auto& q = *queues[(self+k)%queues.size()];
+            scoped_lock lck {q.mtx};
+            if (!q.tasks.empty()) {
+                task = move(q.tasks.front());
+                q.tasks.pop_front();
+            }
+        }
+        if (!task)
+            return false;
+        --pending;
+        task();
+        return true;
+    }
+
+    void run(stop_token tok, size_t i)
+    {
+        current_pool = this;
+        current_index = i;
+        while (!tok.stop_requested()) {
+            if (run_one(i))
+                continue;
+            unique_lock lck {sleep_mtx};
+            cv.wait(lck,tok,[this] { return pending>0; }); // sleep until there is work or we are asked to stop
+        }
+        while (run_one(i)) // graceful shutdown: don't leave futures unsatisfied
+            ;
+    }
+
+    static inline thread_local Work_stealing_pool* current_pool = nullptr; // the pool this thread works for, if any
+    static inline thread_local size_t current_index = 0; // its deque
+
+    vector<unique_ptr<Task_queue>> queues; // unique_ptr: a mutex can't be moved
+    atomic<size_t> next_queue = 0; // round-robin placement of tasks from outside the pool
+    atomic<size_t> pending = 0; // tasks submitted but not yet started
+    mutex sleep_mtx;
+    condition_variable_any cv;
+    vector<jthread> workers; // last: the threads must be stopped before the rest is destroyed
+};
+
+// submit() returns an ordinary future, so code written for packaged_task and thread works unchanged:
+double comp2(Work_stealing_pool& pool, vector<double>& v)
+{
+    double* first = &v[0];
+    size_t n = v.size(); // capture the size, not v: [=] would copy the whole vector into the task
+    future<double> f0 = pool.submit([=] { return accumulate(first,first+n/2,0.0); });
+    future<double> f1 = pool.submit([=] { return accumulate(first+n/2,first+n,0.0); });
+    return f0.get()+f1.get(); // get the results; no thread was created
+}
+
+// Tasks can spawn tasks. Waiting with wait() rather than get() keeps the waiting thread busy:
+double tree_sum(Work_stealing_pool& pool, const double* first, const double* last)
+{
+    if (last-first<=10'000)
+        return accumulate(first,last,0.0);
+    const double* mid = first+(last-first)/2;
+    auto left = pool.submit([=,&pool] { return tree_sum(pool,first,mid); }); // may be stolen by an idle worker
+    double right = tree_sum(pool,mid,last);
+    return pool.wait(left)+right;
+}
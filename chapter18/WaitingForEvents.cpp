@@ -45,3 +45,202 @@ void producer()
     } // release mmutex (at end of scope)
 }
 
+
+// With many producers and consumers, the single mmutex serializes every push() and pop(),
+// and each message is copied out by front() before pop().
+// A bounded ring buffer can instead let threads claim slots with atomic operations alone.
+// Each slot has a sequence number telling whether it is ready to be written (seq==pos)
+// or ready to be read (seq==pos+1); a thread claims a position by a compare-and-exchange on
+// the shared head or tail and then owns that slot until it bumps the slot's sequence number:
+template<typename T>
+class Mpmc_queue {
+public:
+    explicit Mpmc_queue(size_t capacity) // capacity is rounded up to a power of two
+        : mask{bit_ceil(max<size_t>(capacity,2))-1}, slots{new Slot[mask+1]}
+    {
+        for (size_t i = 0; i<=mask; ++i)
+            slots[i].seq.store(i,memory_order_relaxed);
+    }
+    ~Mpmc_queue()
+    {
+        while (pop_with([](T&&) {})) // destroy elements still in the queue, in place
+            ;
+    }
+
+    bool try_push(T&& x) // false if the queue is full
+    {
+        size_t pos = tail.load(memory_order_relaxed);
+        while (true) {
+            Slot& s = slots[pos&mask];
+            size_t seq = s.seq.load(memory_order_acquire);
+            auto diff = static_cast<ptrdiff_t>(seq)-static_cast<ptrdiff_t>(pos);
+            if (diff==0) { // the slot is free: try to claim it
+                if (tail.compare_exchange_weak(pos,pos+1,memory_order_relaxed))
+                    break;
+            }
+            else if (diff<0) // the slot still holds an unread element: full
+                return false;
+            else // another producer got there first
+                pos = tail.load(memory_order_relaxed);
+        }
+        Slot& s = slots[pos&mask];
+        construct_at(s.ptr(),move(x)); // moved, not copied: move-only types are fine
+        s.seq.store(pos+1,memory_order_release); // publish
+        return true;
+    }
+
+    bool try_pop(T& x) // false if the queue is empty
+    {
+        return pop_with([&](T&& v) { x = move(v); });
+    }
+
+    // Claim the oldest element and hand it to f as an rvalue; false if the queue is empty.
+    // T needn't be default constructible: the element is used where it lies, then destroyed.
+    template<typename F>
+    bool pop_with(F f)
+    {
+        size_t pos = head.load(memory_order_relaxed);
+        while (true) {
+            Slot& s = slots[pos&mask];
+            size_t seq = s.seq.load(memory_order_acquire);
+            auto diff = static_cast<ptrdiff_t>(seq)-static_cast<ptrdiff_t>(pos+1);
+            if (diff==0) {
+                if (head.compare_exchange_weak(pos,pos+1,memory_order_relaxed))
+                    break;
+            }
+            else if (diff<0) // nothing written here yet: empty
+                return false;
+            else
+                pos = head.load(memory_order_relaxed);
+        }
+        Slot& s = slots[pos&mask];
+        try {
+            f(move(*s.ptr()));
+        }
+        catch (...) { // the element is lost, but the slot must still be freed
+            destroy_at(s.ptr());
+            s.seq.store(pos+mask+1,memory_order_release);
+            throw;
+        }
+        destroy_at(s.ptr());
+        s.seq.store(pos+mask+1,memory_order_release); // free for the producer one lap later
+        return true;
+    }
+
+    // Batches: move as many of [first:last) / as many elements into out as possible; return how many.
+    // Each element still needs its own slot, but waiting threads are woken once per batch rather than once per element.
+    template<typename It>
+    size_t push_some(It first, It last)
+    {
+        size_t n = 0;
+        for (; first!=last && try_push(move(*first)); ++first)
+            ++n;
+        if (n)
+            wake(pushed);
+        return n;
+    }
+    template<typename Out>
+    size_t pop_some(Out out, size_t max_n)
+    {
+        size_t n = 0;
+        while (n!=max_n && pop_with([&](T&& x) { *out++ = move(x); }))
+            ++n;
+        if (n)
+            wake(popped);
+        return n;
+    }
+
+    // Blocking versions: spin briefly (the other side is usually just about to act), then sleep
+    void push(T x)
+    {
+        wait_until(popped,[&] { return try_push(move(x)); }); // try_push() leaves x alone when it fails
+        wake(pushed);
+    }
+    T pop()
+    {
+        optional<T> x; // constructed from the slot's element, so T needn't have a default constructor
+        wait_until(pushed,[&] { return pop_with([&](T&& v) { x.emplace(move(v)); }); });
+        wake(popped);
+        return move(*x);
+    }
+
+private:
+    struct Slot {
+        atomic<size_t> seq;
+        alignas(T) unsigned char buf[sizeof(T)];
+        T* ptr() { return reinterpret_cast<T*>(buf); }
+    };
+
+    struct Event { // a counter to sleep on, and the number of sleepers (so that wake() is cheap when nobody sleeps)
+        atomic<uint32_t> count = 0;
+        atomic<int> sleepers = 0;
+    };
+
+    template<typename Try>
+    void wait_until(Event& e, Try try_once)
+    {
+        for (int i = 0; i!=100; ++i) { // spin
+            if (try_once())
+                return;
+            if (i>=10)
+                this_thread::yield();
+        }
+        while (true) { // park
+            uint32_t c = e.count.load();
+            ++e.sleepers;
+            if (try_once()) { // re-check after announcing ourselves, so a wake() can't be missed
+                --e.sleepers;
+                return;
+            }
+            e.count.wait(c); // sleeps (e.g., on a futex) until count changes
+            --e.sleepers;
+        }
+    }
+
+    static void wake(Event& e)
+    {
+        ++e.count;
+        if (e.sleepers>0)
+            e.count.notify_all();
+    }
+
+    // head and tail on separate cache lines, so producers and consumers don't slow each other down
+    alignas(64) atomic<size_t> tail = 0;
+    alignas(64) atomic<size_t> head = 0;
+    alignas(64) Event pushed; // consumers wait here for elements
+    alignas(64) Event popped; // producers wait here for space
+    size_t mask;
+    unique_ptr<Slot[]> slots;
+};
+
+// The consumer and producer become:
+Mpmc_queue<Message> mq {1024};
+
+void consumer2()
+{
+    while(true) {
+        Message m = mq.pop(); // no mutex; the message is moved out
+        // ... process m ...
+    }
+}
+
+void producer2()
+{
+    while(true) {
+        Message m;
+        // ... fill the message ...
+        mq.push(move(m));
+    }
+}
+
+void batched_consumer()
+{
+    vector<Message> batch;
+    while(true) {
+        batch.clear();
+        if (mq.pop_some(back_inserter(batch),64)==0) { // take up to 64 messages at a time
+            batch.push_back(mq.pop()); // nothing there: wait for one
+        }
+        // ... process batch ...
+    }
+}
@@ -61,3 +61,119 @@ Vector f() {
 
 // The standard-library function move() doesn’t actually move anything. Instead, it returns a reference
 // to its argument from which we may move – an rvalue reference; it is a kind of cast
+
+// Moving removes the copy out of operator+(), but r = x + y + z still creates one temporary Vector per +
+// and walks through memory once per +. For long Vectors, the cost is in the allocations and the memory traffic,
+// not in the additions.
+// We can do better by not computing anything in operator+(). Instead, + returns a small object describing
+// the computation (an "expression template"), and the whole expression is evaluated, element by element,
+// when it is finally assigned to a Vector:
+//     r = x + y + z;  // one loop: r[i] = x[i] + y[i] + z[i]; no temporary Vectors
+
+template<typename E>
+struct Vec_expr { // base of all expression nodes; E is the derived node type
+    double operator[](int i) const { return static_cast<const E&>(*this)[i]; }
+    int size() const { return static_cast<const E&>(*this).size(); }
+};
+
+// A Vector is held by reference (it outlives the full-expression); a node is held by value (it is a temporary):
+template<typename T>
+using Operand = conditional_t<is_same_v<remove_cvref_t<T>,Vector>, const Vector&, remove_cvref_t<T>>;
+
+template<typename T>
+concept Vector_operand = is_same_v<remove_cvref_t<T>,Vector> || is_base_of_v<Vec_expr<remove_cvref_t<T>>, remove_cvref_t<T>>;
+
+template<typename L, typename R, typename Op>
+struct Binary_expr : Vec_expr<Binary_expr<L,R,Op>> {
+    Operand<L> l;
+    Operand<R> r;
+    Binary_expr(const L& ll, const R& rr) : l{ll}, r{rr}
+    {
+        if (l.size() != r.size())
+            throw Vector_size_mismatch{}; // detected when the expression is built, not when it is evaluated
+    }
+    double operator[](int i) const { return Op{}(l[i], r[i]); }
+    int size() const { return l.size(); }
+};
+
+template<typename E>
+struct Scaled_expr : Vec_expr<Scaled_expr<E>> { // a*e; also used for -e (a == -1)
+    double a;
+    Operand<E> e;
+    Scaled_expr(double aa, const E& ee) : a{aa}, e{ee} {}
+    double operator[](int i) const { return a*e[i]; }
+    int size() const { return e.size(); }
+};
+
+template<typename A, typename B, typename C>
+struct Fma_expr : Vec_expr<Fma_expr<A,B,C>> { // a*b+c, elementwise, with a single rounding
+    Operand<A> a;
+    Operand<B> b;
+    Operand<C> c;
+    Fma_expr(const A& aa, const B& bb, const C& cc) : a{aa}, b{bb}, c{cc}
+    {
+        if (a.size() != b.size() || a.size() != c.size())
+            throw Vector_size_mismatch{};
+    }
+    double operator[](int i) const { return std::fma(a[i], b[i], c[i]); }
+    int size() const { return a.size(); }
+};
+
+// These replace the operator+() defined at the start of this section:
+template<Vector_operand L, Vector_operand R>
+auto operator+(const L& l, const R& r) { return Binary_expr<L,R,plus<>>{l,r}; }
+
+template<Vector_operand L, Vector_operand R>
+auto operator-(const L& l, const R& r) { return Binary_expr<L,R,minus<>>{l,r}; }
+
+template<Vector_operand E>
+auto operator*(double a, const E& e) { return Scaled_expr<E>{a,e}; }
+
+template<Vector_operand E>
+auto operator*(const E& e, double a) { return Scaled_expr<E>{a,e}; }
+
+template<Vector_operand E>
+auto operator-(const E& e) { return Scaled_expr<E>{-1,e}; }
+
+template<Vector_operand A, Vector_operand B, Vector_operand C>
+auto fma(const A& a, const B& b, const C& c) { return Fma_expr<A,B,C>{a,b,c}; }
+
+// Vector needs to know how to be initialized from and assigned an expression:
+class Vector {
+    // ...
+    template<typename E>
+    Vector(const Vec_expr<E>& e); // evaluate e into new elements
+    template<typename E>
+    Vector& operator=(const Vec_expr<E>& e); // evaluate e into the existing elements
+};
+
+template<typename E>
+Vector::Vector(const Vec_expr<E>& e)
+    : elem{new double[e.size()]}, sz{e.size()} {
+    for (int i = 0; i != sz; ++i) // the only loop: the whole expression is evaluated per element
+        elem[i] = e[i];
+}
+
+template<typename E>
+Vector& Vector::operator=(const Vec_expr<E>& e)
+{
+    if (sz != e.size()) { // only reallocate if we must; then *this cannot be an operand of e
+        double* p = new double[e.size()];
+        delete[] elem;
+        elem = p;
+        sz = e.size();
+    }
+    for (int i = 0; i != sz; ++i) // element i depends only on operand elements i, so x = x + y is fine
+        elem[i] = e[i];
+    return *this;
+}
+
+// Now, f() does no allocation for the sum (unless r must change size) and a single pass over x, y, z, and r:
+void f2(const Vector &x, const Vector &y, const Vector &z) {
+    Vector r(x.size());
+    r = x + y + z; // Binary_expr<Binary_expr<Vector,Vector,plus<>>,Vector,plus<>>; nothing is computed until =
+    r = 2.0*x - y; // a scaled difference, still one loop
+    r = fma(x, y, r); // r[i] = x[i]*y[i] + r[i]
+}
+// Note that auto e = x + y; keeps references to x and y; an expression should be used where it is written,
+// not stored for later.